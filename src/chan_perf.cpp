@@ -1,43 +1,308 @@
-#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <pthread.h>
 #include <thread>
+#include <type_traits>
+#include <vector>
 #include "snackis/core/chan.hpp"
+#include "snackis/core/fmt.hpp"
+#include "snackis/core/str.hpp"
 
 using namespace snackis;
 
-void run_pub(Chan<int> *ch, int reps) {
+// Runs each channel implementation over all worker/buffer combinations,
+// every worker being one producer and one consumer thread moving reps
+// items. Output matches go/chan_perf.go column for column; latencies are
+// per call, which means per batch for batched runs.
+//
+// chan_perf [--format=text|csv|json] [--runs=N] [--warmup=N] [--reps=N] [--pin]
+
+using PerfClock = std::chrono::steady_clock;
+using Lats = std::vector<int64_t>;
+
+// Previous mutex based channel, kept as baseline
+template <typename T>
+struct LockChan {
+  const size_t max;
+  std::deque<T> buf;
+  std::mutex mutex;
+  std::condition_variable get_ok, put_ok;
+
+  LockChan(size_t max): max(max) { }
+};
+
+template <typename T>
+void put(LockChan<T> &c, const T &it) {
+  std::unique_lock<std::mutex> lock(c.mutex);
+  c.put_ok.wait(lock, [&c](){ return c.buf.size() < c.max; });
+  c.buf.push_back(it);
+  c.get_ok.notify_one();
+}
+
+template <typename T>
+opt<T> get(LockChan<T> &c) {
+  std::unique_lock<std::mutex> lock(c.mutex);
+  c.get_ok.wait(lock, [&c](){ return !c.buf.empty(); });
+  auto out(c.buf.front());
+  c.buf.pop_front();
+  c.put_ok.notify_one();
+  return out;
+}
+
+struct Opts {
+  str format;
+  int64_t runs, warmup, reps;
+  bool pin;
+
+  Opts(): format("text"), runs(5), warmup(1), reps(100000), pin(false) { }
+};
+
+struct Bench {
+  str impl;
+  int64_t workers, buf;
+};
+
+struct Sample {
+  int64_t wall, cpu;
+  Lats put_lats, get_lats;
+
+  Sample(): wall(0), cpu(0) { }
+};
+
+struct Result {
+  Bench bench;
+  int64_t msgs, rate, put_p50, put_p99, get_p50, get_p99, cpu, wall;
+};
+
+static int64_t nsecs(PerfClock::time_point start) {
+  auto d(PerfClock::now()-start);
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+static int64_t cpu_nsecs() {
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return int64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static void pin(std::thread &t, size_t i) {
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(i % std::max(std::thread::hardware_concurrency(), 1u), &cpus);
+  pthread_setaffinity_np(t.native_handle(), sizeof cpus, &cpus);
+}
+
+static int64_t pct(Lats &lats, size_t p) {
+  if (lats.empty()) { return 0; }
+  auto i(lats.begin() + std::min(lats.size()-1, lats.size() * p / 100));
+  std::nth_element(lats.begin(), i, lats.end());
+  return *i;
+}
+
+template <typename ChanT>
+void run_pub(ChanT *ch, int64_t reps, Lats *lats) {
   for (int i(0); i < reps; i++) {
+    auto start(PerfClock::now());
     put(*ch, i);
+    lats->push_back(nsecs(start));
   }
 }
 
-void run_con(Chan<int> *ch, int reps) {
+template <typename ChanT>
+void run_con(ChanT *ch, int64_t reps, Lats *lats) {
   for (int i(0); i < reps; i++) {
+    auto start(PerfClock::now());
     get(*ch);
+    lats->push_back(nsecs(start));
+  }
+}
+
+static void run_batch_pub(Chan<int> *ch, int64_t reps, Lats *lats) {
+  std::vector<int> its(reps);
+  std::iota(its.begin(), its.end(), 0);
+
+  for (int64_t i(0); i < reps;) {
+    auto n(std::min<int64_t>(ch->max, reps-i));
+    auto start(PerfClock::now());
+    put_all(*ch, its.begin()+i, its.begin()+i+n);
+    lats->push_back(nsecs(start));
+    i += n;
+  }
+}
+
+static void run_batch_con(Chan<int> *ch, int64_t reps, Lats *lats) {
+  std::vector<int> its;
+
+  for (int64_t i(0); i < reps;) {
+    its.clear();
+    auto start(PerfClock::now());
+    i += drain(*ch, its, std::min<int64_t>(ch->max, reps-i));
+    lats->push_back(nsecs(start));
   }
 }
 
-void run(int workers, int reps, int buf) {
+template <typename ChanT>
+Sample run(const Bench &b, const Opts &opts, bool batch) {
+  ChanT ch(b.buf);
+  std::vector<Lats> put_lats(b.workers), get_lats(b.workers);
   std::vector<std::thread> wg;
-  Chan<int> ch(buf);
-  
-  for (int i(0); i < workers; i++) {
-    wg.emplace_back(run_pub, &ch, reps);
-    wg.emplace_back(run_con, &ch, reps);
+  auto start(PerfClock::now());
+  auto cpu_start(cpu_nsecs());
+
+  for (int64_t i(0); i < b.workers; i++) {
+    put_lats[i].reserve(opts.reps);
+    get_lats[i].reserve(opts.reps);
+
+    if constexpr (std::is_same<ChanT, Chan<int>>::value) {
+      if (batch) {
+	wg.emplace_back(run_batch_pub, &ch, opts.reps, &put_lats[i]);
+	wg.emplace_back(run_batch_con, &ch, opts.reps, &get_lats[i]);
+      }
+    }
+
+    if (!batch) {
+      wg.emplace_back(run_pub<ChanT>, &ch, opts.reps, &put_lats[i]);
+      wg.emplace_back(run_con<ChanT>, &ch, opts.reps, &get_lats[i]);
+    }
+
+    if (opts.pin) {
+      pin(wg[wg.size()-2], wg.size()-2);
+      pin(wg.back(), wg.size()-1);
+    }
   }
 
   for (auto &t: wg) { t.join(); }
+  Sample out;
+  out.wall = nsecs(start);
+  out.cpu = cpu_nsecs() - cpu_start;
+
+  for (int64_t i(0); i < b.workers; i++) {
+    out.put_lats.insert(out.put_lats.end(),
+			put_lats[i].begin(), put_lats[i].end());
+    out.get_lats.insert(out.get_lats.end(),
+			get_lats[i].begin(), get_lats[i].end());
+  }
+
+  return out;
+}
+
+static Sample run(const Bench &b, const Opts &opts) {
+  if (b.impl == "lock") { return run<LockChan<int>>(b, opts, false); }
+  if (b.impl == "ring") { return run<Chan<int>>(b, opts, false); }
+  if (b.impl == "batch") { return run<Chan<int>>(b, opts, true); }
+  return run<Chan<int, CHAN_SINGLE, CHAN_SINGLE>>(b, opts, false);
+}
+
+// Throughput is the median of runs, latencies are pooled across runs and
+// times averaged
+static Result bench(const Bench &b, const Opts &opts) {
+  for (int64_t i(0); i < opts.warmup; i++) { run(b, opts); }
+  Result res{b, b.workers * opts.reps, 0, 0, 0, 0, 0, 0, 0};
+  Lats rates, put_lats, get_lats;
+
+  for (int64_t i(0); i < opts.runs; i++) {
+    auto s(run(b, opts));
+    rates.push_back(res.msgs * 1000000000 / std::max<int64_t>(s.wall, 1));
+    put_lats.insert(put_lats.end(), s.put_lats.begin(), s.put_lats.end());
+    get_lats.insert(get_lats.end(), s.get_lats.begin(), s.get_lats.end());
+    res.cpu += s.cpu / 1000;
+    res.wall += s.wall / 1000;
+  }
+
+  res.rate = pct(rates, 50);
+  res.put_p50 = pct(put_lats, 50);
+  res.put_p99 = pct(put_lats, 99);
+  res.get_p50 = pct(get_lats, 50);
+  res.get_p99 = pct(get_lats, 99);
+  res.cpu /= opts.runs;
+  res.wall /= opts.runs;
+  return res;
+}
+
+const std::vector<str> COLS({"impl", "workers", "buf", "msgs", "msgs_per_sec",
+      "put_p50_ns", "put_p99_ns", "get_p50_ns", "get_p99_ns",
+      "cpu_us", "wall_us"});
+
+static void print_row(const std::vector<str> &vals, const Opts &opts) {
+  for (size_t i(0); i < vals.size(); i++) {
+    if (opts.format == "csv") {
+      if (i) { std::cout << ','; }
+      std::cout << vals[i];
+    } else {
+      std::cout << std::setw(i ? 13 : 6) << vals[i];
+    }
+  }
+
+  std::cout << std::endl;
+}
+
+static void print(const Result &r, const Opts &opts) {
+  const std::vector<int64_t> nums({r.bench.workers, r.bench.buf, r.msgs,
+	r.rate, r.put_p50, r.put_p99, r.get_p50, r.get_p99, r.cpu, r.wall});
+
+  if (opts.format == "json") {
+    std::cout << fmt("{\"%0\": \"%1\"", COLS[0], r.bench.impl);
+
+    for (size_t i(0); i < nums.size(); i++) {
+      std::cout << fmt(", \"%0\": %1", COLS[i+1], nums[i]);
+    }
+
+    std::cout << '}' << std::endl;
+    return;
+  }
+
+  std::vector<str> vals({r.bench.impl});
+  for (auto n: nums) { vals.push_back(fmt_arg(n)); }
+  print_row(vals, opts);
 }
 
-const int
-  MAX_WORKERS(   5),
-  MAX_REPS(1000000),
-  MAX_BUF(    1000);
+static bool parse_opts(int argc, char *argv[], Opts &opts) {
+  for (int i(1); i < argc; i++) {
+    const str a(argv[i]);
+    const str v(a.substr(a.find('=')+1));
+
+    if (a.find("--format=") == 0 &&
+	(v == "text" || v == "csv" || v == "json")) {
+      opts.format = v;
+    } else if (a.find("--runs=") == 0) {
+      opts.runs = std::max<int64_t>(to_int64(v), 1);
+    } else if (a.find("--warmup=") == 0) {
+      opts.warmup = to_int64(v);
+    } else if (a.find("--reps=") == 0) {
+      opts.reps = std::max<int64_t>(to_int64(v), 1);
+    } else if (a == "--pin") {
+      opts.pin = true;
+    } else {
+      std::cerr << fmt("Invalid option: %0", a) << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+const std::vector<int64_t>
+  WORKERS({1, 2, 4}),
+  BUFS({1, 10, 100, 1000});
+
+int main(int argc, char *argv[]) {
+  Opts opts;
+  if (!parse_opts(argc, argv, opts)) { return -1; }
+  if (opts.format != "json") { print_row(COLS, opts); }
+
+  for (const str impl: {"lock", "ring", "batch", "spsc"}) {
+    for (auto workers: WORKERS) {
+      if (impl == "spsc" && workers > 1) { continue; }
 
-int main() {
-  for (int workers(1); workers < MAX_WORKERS; workers++) {
-    for(int reps(10); reps < MAX_REPS; reps *= 10) {
-      for(int buf(1); buf < MAX_BUF; buf *= 10) {
-	run(workers, reps, buf);
+      for (auto buf: BUFS) {
+	print(bench({impl, workers, buf}, opts), opts);
       }
     }
   }
@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "snackis/core/int64_type.hpp"
+#include "snackis/core/str_type.hpp"
+#include "snackis/core/time_type.hpp"
+#include "snackis/core/uid_type.hpp"
+#include "snackis/core/utils.hpp"
+#include "snackis/crypt/secret.hpp"
+#include "snackis/db/col.hpp"
+#include "snackis/db/id_index.hpp"
+#include "snackis/db/key.hpp"
+#include "snackis/db/proc.hpp"
+#include "snackis/db/query.hpp"
+#include "snackis/db/table.hpp"
+#include "snackis/db/text_index.hpp"
+#include "snackis/db/trans.hpp"
+
+using namespace snackis;
+using namespace snackis::db;
+
+using PerfClock = std::chrono::steady_clock;
+
+// Keeps results of measured loops alive
+volatile int64_t perf_sink;
+
+struct PerfRec {
+  UId id;
+  Time created_at;
+  int64_t prio;
+  str body;
+
+  PerfRec(int64_t i):
+    id(true), created_at(now()), prio(i), body(fmt("Perf record #%0", i))
+  { }
+};
+
+const Col<PerfRec, UId> perf_id("id", uid_type, &PerfRec::id);
+const Col<PerfRec, Time> perf_created_at("created_at",
+					 time_type,
+					 &PerfRec::created_at);
+const Col<PerfRec, int64_t> perf_prio("prio", int64_type, &PerfRec::prio);
+const Col<PerfRec, str> perf_body("body", str_type, &PerfRec::body);
+
+static int64_t msecs(PerfClock::time_point start) {
+  auto d(PerfClock::now()-start);
+  return std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+}
+
+static int64_t usecs(PerfClock::time_point start) {
+  auto d(PerfClock::now()-start);
+  return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+static void rec_perf(Ctx &ctx, int64_t recs, int reps) {
+  Table<PerfRec, UId> tbl(ctx, "rec_perf", make_key(perf_id),
+			  {&perf_created_at, &perf_prio, &perf_body});
+  std::vector<db::Rec<PerfRec>> src;
+  for (int64_t i(0); i < recs; i++) { src.emplace_back(tbl, PerfRec(i)); }
+  auto start(PerfClock::now());
+
+  for (int i(0); i < reps; i++) {
+    std::vector<db::Rec<PerfRec>> dst(src);
+  }
+
+  std::cout << fmt("copy %0 recs: %1ms", recs, msecs(start)/reps) << std::endl;
+  start = PerfClock::now();
+  int64_t n(0);
+  
+  for (int i(0); i < reps; i++) {
+    for (auto &r: src) { n += *get(r, perf_prio); }
+  }
+
+  perf_sink = n;
+  std::cout << fmt("get %0 recs: %1us", recs, usecs(start)/reps) << std::endl;
+}
+
+template <typename MapT, typename KeyT>
+static void lookup_perf(const str &name, const std::vector<KeyT> &keys, int reps) {
+  MapT m;
+  for (auto &k: keys) { m.emplace(k, int64_t(0)); }
+  auto start(PerfClock::now());
+  int64_t n(0);
+  
+  for (int i(0); i < reps; i++) {
+    for (auto &k: keys) { n += m.find(k)->second; }
+  }
+
+  const int64_t find_time(usecs(start));
+  start = PerfClock::now();
+  
+  for (int i(0); i < reps; i++) {
+    for (auto &it: m) { n += it.second; }
+  }
+
+  perf_sink = n;
+  std::cout << fmt("%0 %1 keys: find %2us, iterate %3us",
+		   name, keys.size(), find_time/reps, usecs(start)/reps)
+	    << std::endl;
+}
+
+template <typename MapT, typename KeyT>
+static void sorted_perf(const str &name, const std::vector<KeyT> &keys, int reps) {
+  MapT m;
+  for (auto &k: keys) { m.emplace(k, int64_t(0)); }
+  auto start(PerfClock::now());
+  int64_t n(0);
+  
+  for (int i(0); i < reps; i++) {
+    for (auto &k: keys) { n += m.lower_bound(k)->second; }
+  }
+
+  const int64_t find_time(usecs(start));
+  start = PerfClock::now();
+  
+  for (int i(0); i < reps; i++) {
+    for (auto it(m.rbegin()); it != m.rend(); it++) { n += it->second; }
+  }
+
+  perf_sink = n;
+  std::cout << fmt("%0 %1 keys: lower_bound %2us, reverse iterate %3us",
+		   name, keys.size(), find_time/reps, usecs(start)/reps)
+	    << std::endl;
+}
+
+static void store_perf(int64_t recs, int reps) {
+  using IdKey = std::tuple<UId>;
+  using SortKey = std::tuple<Time, UId>;
+  std::vector<IdKey> ids;
+  std::vector<SortKey> sorted;
+  
+  for (int64_t i(0); i < recs; i++) {
+    ids.emplace_back(UId(true));
+    sorted.emplace_back(now(), UId(true));
+  }
+
+  // Look keys up in random order
+  std::shuffle(sorted.begin(), sorted.end(), std::mt19937());
+  
+  lookup_perf<std::map<IdKey, int64_t>>("map", ids, reps);
+  lookup_perf<HashMap<IdKey, int64_t, UIdKeyHash>>("hash", ids, reps);
+  sorted_perf<std::map<SortKey, int64_t>>("map", sorted, reps);
+  sorted_perf<BTree<SortKey, int64_t>>("btree", sorted, reps);
+}
+
+static void slurp_perf(Ctx &ctx, int64_t recs, int reps) {
+  Table<PerfRec, UId> tbl(ctx, "slurp_perf", make_key(perf_id),
+			  {&perf_created_at, &perf_prio, &perf_body});
+
+  for (int64_t i(0); i < recs; i++) {
+    PerfRec rec(i);
+    tbl.recs.emplace(tbl.key(rec), db::Rec<PerfRec>(tbl, rec));
+  }
+
+  const size_t page_size(ctx.proc.page_size);
+  
+  for (auto ps: {size_t(0), page_size}) {
+    ctx.proc.page_size = ps;
+    std::ofstream f(tbl.path.string(),
+		    std::ios::out | std::ios::binary | std::ios::trunc);
+    dump(tbl, f);
+    f.close();
+    
+    for (auto map_files: {false, true}) {
+      ctx.proc.map_files = map_files;
+      auto start(PerfClock::now());
+      
+      for (int i(0); i < reps; i++) {
+	tbl.recs.clear();
+	slurp(tbl);
+      }
+      
+      std::cout << fmt("slurp %0 %1 %2 recs: %3ms (%4 bytes)",
+		       map_files ? "mapped" : "stream", ps ? "paged" : "boxed",
+		       recs, msecs(start)/reps, path_size(tbl.path))
+		<< std::endl;
+    }
+  }
+}
+
+static void snapshot_perf(Ctx &ctx, int64_t recs, int64_t updates, int reps) {
+  Table<PerfRec, UId> tbl(ctx, "snapshot_perf", make_key(perf_id),
+			  {&perf_created_at, &perf_prio, &perf_body});
+  std::vector<PerfRec> rs;
+  for (int64_t i(0); i < recs; i++) { rs.emplace_back(i); }
+
+  std::ofstream f(tbl.path.string(),
+		  std::ios::out | std::ios::binary | std::ios::trunc);
+  write_schema(tbl, f);
+  for (auto &r: rs) { write(tbl, TABLE_INSERT, db::Rec<PerfRec>(tbl, r), f); }
+
+  for (int64_t i(0); i < updates; i++) {
+    for (auto &r: rs) {
+      r.prio++;
+      write(tbl, TABLE_UPDATE, db::Rec<PerfRec>(tbl, r), f);
+    }
+  }
+  
+  f.close();
+  remove_path(tbl.snap_path);
+  
+  for (auto snap: {false, true}) {
+    if (snap) {
+      const int64_t size(path_size(tbl.path));
+      std::ofstream out(tbl.snap_path.string(),
+			std::ios::out | std::ios::binary | std::ios::trunc);
+      write_snapshot_header(size, 0, out);
+      compact(tbl, size, out);
+    }
+    
+    auto start(PerfClock::now());
+    
+    for (int i(0); i < reps; i++) {
+      tbl.recs.clear();
+      slurp(tbl);
+    }
+
+    std::cout << fmt("slurp %0 %1 recs x %2 updates: %3ms",
+		     snap ? "snapshot" : "log", recs, updates,
+		     msecs(start)/reps)
+	      << std::endl;
+  }
+}
+
+static void trans_perf(Ctx &ctx, int64_t recs, int reps) {
+  Table<PerfRec, UId> tbl(ctx, "trans_perf", make_key(perf_id),
+			  {&perf_created_at, &perf_prio, &perf_body});
+  std::vector<db::Rec<PerfRec>> rs;
+  for (int64_t i(0); i < recs; i++) { rs.emplace_back(tbl, PerfRec(i)); }
+  auto start(PerfClock::now());
+  
+  for (int i(0); i < reps; i++) {
+    Trans trans(ctx);
+    for (auto &r: rs) { insert(tbl, r); }
+    rollback(trans);
+  }
+
+  std::cout << fmt("trans %0 inserts: %1us", recs, usecs(start)/reps)
+	    << std::endl;
+}
+
+static void commit_perf(Ctx &ctx, Durability durability, int64_t commits) {
+  static const str names[] = {"none", "flush", "group", "commit"};
+  Table<PerfRec, UId> tbl(ctx, "commit_perf", make_key(perf_id),
+			  {&perf_created_at, &perf_prio, &perf_body});
+  auto &lp(ctx.proc.write_loop);
+  ctx.proc.durability = durability;
+  sync(ctx);
+  const WriteStats prev(lp.stats);
+  auto start(PerfClock::now());
+  
+  for (int64_t i(0); i < commits; i++) {
+    Trans trans(ctx);
+    insert(tbl, PerfRec(i));
+    commit(trans, nullopt);
+  }
+
+  sync(ctx);
+  const int64_t
+    time(max(msecs(start), int64_t(1))),
+    n(lp.stats.commits - prev.commits),
+    groups(lp.stats.groups - prev.groups);
+  
+  std::cout << fmt("commit %0 %1 commits: %2ms, %3 commits/s, "
+		   "%4us avg latency, %5 commits/group, %6 syncs",
+		   names[durability], n, time, n*1000/time,
+		   (lp.stats.latency - prev.latency) / max(n, int64_t(1)),
+		   n / max(groups, int64_t(1)),
+		   lp.stats.syncs - prev.syncs)
+	    << std::endl;
+}
+
+const int64_t
+  MAX_RECS(100000),
+  UPDATES(10),
+  COMMITS(10000),
+  TRANS_RECS(500),
+  REPS(5);
+
+static void query_perf(Ctx &ctx, int64_t recs, int reps) {
+  Table<PerfRec, UId> tbl(ctx, "query_perf", make_key(perf_id),
+			  {&perf_created_at, &perf_prio, &perf_body});
+  KeyIndex<PerfRec, Time, UId> idx(make_key(perf_created_at, perf_id));
+  tbl.indexes.insert(&idx);
+  
+  for (int64_t i(0); i < recs; i++) {
+    PerfRec rec(i);
+    rec.created_at = null_time+std::chrono::seconds(i);
+    auto &r(tbl.recs.emplace(tbl.key(rec), db::Rec<PerfRec>(tbl, rec)).first->second);
+    insert(idx, r);
+  }
+
+  const opt<Time>
+    min(null_time+std::chrono::seconds(recs/2)),
+    max(null_time+std::chrono::seconds(recs/2+100));
+  
+  for (auto rank: {SOURCE_ALL, SOURCE_RANGE}) {
+    auto start(PerfClock::now());
+    size_t n(0);
+    
+    for (int i(0); i < reps; i++) {
+      Query<PerfRec> q;
+      q.limit = 10;
+      
+      if (rank == SOURCE_RANGE) {
+	auto cur(scan(idx, SCAN_REV));
+	seek(cur, idx.key(*max+std::chrono::seconds(1), null_uid));
+	bound(cur, idx.key(*min, null_uid));
+	from(q, cur, rank);
+      } else {
+	from(q, scan(idx, SCAN_REV), rank);
+      }
+      
+      range(q, perf_created_at, min, max);
+      contains(q, {&perf_body}, "#");
+      n += run(q).size();
+    }
+
+    perf_sink = n;
+    std::cout << fmt("query %0 %1 recs: %2us",
+		     rank == SOURCE_ALL ? "scan" : "range",
+		     recs, usecs(start)/reps) << std::endl;
+  }
+}
+
+static void text_perf(Ctx &ctx, int64_t recs, int reps) {
+  Table<PerfRec, UId> tbl(ctx, "text_perf", make_key(perf_id),
+			  {&perf_created_at, &perf_prio, &perf_body});
+  KeyIndex<PerfRec, Time, UId> idx(make_key(perf_created_at, perf_id));
+  TextIndex<PerfRec> text({&perf_body});
+  tbl.indexes.insert(&idx);
+  tbl.indexes.insert(&text);
+  
+  for (int64_t i(0); i < recs; i++) {
+    PerfRec rec(i);
+    tbl.recs.emplace(tbl.key(rec), db::Rec<PerfRec>(tbl, rec));
+  }
+
+  reindex(tbl);
+  const str sel(to_str(recs/2));
+  
+  for (auto rank: {SOURCE_ALL, SOURCE_MATCH}) {
+    auto start(PerfClock::now());
+    size_t n(0);
+    
+    for (int i(0); i < reps; i++) {
+      Query<PerfRec> q;
+      from(q, scan(idx, SCAN_REV), SOURCE_ALL);
+      if (rank == SOURCE_MATCH) { match(q, text, idx, sel, SCAN_REV); }
+      contains(q, {&perf_body}, sel);
+      n += run(q).size();
+    }
+
+    perf_sink = n;
+    std::cout << fmt("text %0 %1 recs: %2us",
+		     rank == SOURCE_ALL ? "scan" : "match",
+		     recs, usecs(start)/reps) << std::endl;
+  }
+}
+
+static void id_perf(Ctx &ctx, int64_t recs, int reps) {
+  Table<PerfRec, UId> tbl(ctx, "id_perf", make_key(perf_id),
+			  {&perf_created_at, &perf_prio, &perf_body});
+  IdIndex<PerfRec> idx(make_key(perf_id));
+  tbl.indexes.insert(&idx);
+  
+  for (int64_t i(0); i < recs; i++) {
+    PerfRec rec(i);
+    tbl.recs.emplace(tbl.key(rec), db::Rec<PerfRec>(tbl, rec));
+  }
+
+  reindex(tbl);
+  const str sel(to_str(std::get<0>(idx.recs.begin()->first)).substr(0, 6));
+  auto start(PerfClock::now());
+  size_t n(0);
+  
+  for (int i(0); i < reps; i++) {
+    for (auto &r: tbl.recs) {
+      if (find_ci(to_str(*get(r.second, perf_id)).substr(0, 8), sel) != str::npos) {
+	n++;
+      }
+    }
+  }
+
+  std::cout << fmt("id scan %0 recs: %1us", recs, usecs(start)/reps) << std::endl;
+  start = PerfClock::now();
+  
+  for (int i(0); i < reps; i++) { n += find_prefix(idx, sel).size(); }
+  perf_sink = n;
+  std::cout << fmt("id prefix %0 recs: %1us", recs, usecs(start)/reps) << std::endl;
+}
+
+int main() {
+  TRY(try_perf);
+  Proc proc("perfdb/", 32);
+  Ctx ctx(proc, 32);
+  ctx.secret.emplace();
+  crypt::init_salt(*ctx.secret);
+  crypt::init(*ctx.secret, "perf");
+
+  rec_perf(ctx, MAX_RECS, REPS);
+  store_perf(MAX_RECS, REPS);
+  
+  for (int64_t recs(1000); recs <= MAX_RECS; recs *= 10) {
+    slurp_perf(ctx, recs, REPS);
+  }
+
+  snapshot_perf(ctx, MAX_RECS / 10, UPDATES, REPS);
+  trans_perf(ctx, TRANS_RECS, REPS*100);
+  query_perf(ctx, MAX_RECS, REPS);
+
+  for (int64_t recs(1000); recs <= MAX_RECS; recs *= 10) {
+    text_perf(ctx, recs, REPS);
+  }
+
+  id_perf(ctx, MAX_RECS, REPS);
+
+  for (auto d: {DURABLE_NONE, DURABLE_FLUSH, DURABLE_GROUP, DURABLE_COMMIT}) {
+    commit_perf(ctx, d, COMMITS);
+  }
+  
+  return 0;
+}
@@ -1,55 +1,250 @@
+// Go counterpart of chan_perf.cpp, output matches column for column.
+//
+// chan_perf [--format=text|csv|json] [--runs=N] [--warmup=N] [--reps=N] [--pin]
+
 package main
 
 import (
+	"flag"
+	"fmt"
+	"os"
 	"runtime"
+	"sort"
+	"strconv"
+	"strings"
 	"sync"
+	"syscall"
+	"time"
+	"unsafe"
 )
 
-func run_pub(wg *sync.WaitGroup, ch chan int, reps int) {
+type Opts struct {
+	format             string
+	runs, warmup, reps int
+	pin                bool
+}
+
+type Bench struct {
+	impl         string
+	workers, buf int
+}
+
+type Sample struct {
+	wall, cpu        int64
+	putLats, getLats []int64
+}
+
+type Result struct {
+	bench                                      Bench
+	msgs, rate, putP50, putP99, getP50, getP99 int64
+	cpu, wall                                  int64
+}
+
+func cpuNsecs() int64 {
+	var ru syscall.Rusage
+	syscall.Getrusage(syscall.RUSAGE_SELF, &ru)
+	return ru.Utime.Nano() + ru.Stime.Nano()
+}
+
+// Pins the calling thread, which has to be locked to its goroutine
+func pin(i int) {
+	var cpus [16]uint64
+	n := runtime.NumCPU()
+	cpu := i % n
+	cpus[cpu/64] |= 1 << uint(cpu%64)
+	syscall.RawSyscall(syscall.SYS_SCHED_SETAFFINITY, 0,
+		uintptr(len(cpus)*8), uintptr(unsafe.Pointer(&cpus[0])))
+}
+
+func pct(lats []int64, p int) int64 {
+	if len(lats) == 0 {
+		return 0
+	}
+
+	sort.Slice(lats, func(i, j int) bool { return lats[i] < lats[j] })
+	i := len(lats) * p / 100
+	if i > len(lats)-1 {
+		i = len(lats) - 1
+	}
+
+	return lats[i]
+}
+
+func runPub(wg *sync.WaitGroup, ch chan int, reps int, lats *[]int64, cpu int) {
 	runtime.LockOSThread()
-	
+	if cpu >= 0 {
+		pin(cpu)
+	}
+
 	for i := 0; i < reps; i++ {
-		ch<- i
+		start := time.Now()
+		ch <- i
+		*lats = append(*lats, int64(time.Since(start)))
 	}
-	
+
 	wg.Done()
 }
 
-func run_con(wg *sync.WaitGroup, ch chan int, reps int) {
+func runCon(wg *sync.WaitGroup, ch chan int, reps int, lats *[]int64, cpu int) {
 	runtime.LockOSThread()
+	if cpu >= 0 {
+		pin(cpu)
+	}
 
 	for i := 0; i < reps; i++ {
+		start := time.Now()
 		<-ch
+		*lats = append(*lats, int64(time.Since(start)))
 	}
-	
+
 	wg.Done()
 }
 
-func run(workers, reps, buf int) {
+func run(b Bench, opts Opts) Sample {
 	var wg sync.WaitGroup
-	ch := make(chan int, buf)
-	
-	for i := 0; i < workers; i++ {
+	ch := make(chan int, b.buf)
+	putLats := make([][]int64, b.workers)
+	getLats := make([][]int64, b.workers)
+	start := time.Now()
+	cpuStart := cpuNsecs()
+
+	for i := 0; i < b.workers; i++ {
+		putLats[i] = make([]int64, 0, opts.reps)
+		getLats[i] = make([]int64, 0, opts.reps)
+		pubCpu, conCpu := -1, -1
+
+		if opts.pin {
+			pubCpu, conCpu = i*2, i*2+1
+		}
+
 		wg.Add(2)
-		go run_pub(&wg, ch, reps)
-		go run_con(&wg, ch, reps)
+		go runPub(&wg, ch, opts.reps, &putLats[i], pubCpu)
+		go runCon(&wg, ch, opts.reps, &getLats[i], conCpu)
 	}
 
 	wg.Wait()
+	out := Sample{wall: int64(time.Since(start)), cpu: cpuNsecs() - cpuStart}
+
+	for i := 0; i < b.workers; i++ {
+		out.putLats = append(out.putLats, putLats[i]...)
+		out.getLats = append(out.getLats, getLats[i]...)
+	}
+
+	return out
 }
 
-const (
-	MAX_WORKERS =    5
-	MAX_REPS = 1000000
-	MAX_BUF =     1000
+// Throughput is the median of runs, latencies are pooled across runs and
+// times averaged
+func bench(b Bench, opts Opts) Result {
+	for i := 0; i < opts.warmup; i++ {
+		run(b, opts)
+	}
+
+	res := Result{bench: b, msgs: int64(b.workers * opts.reps)}
+	var rates, putLats, getLats []int64
+
+	for i := 0; i < opts.runs; i++ {
+		s := run(b, opts)
+		wall := s.wall
+		if wall < 1 {
+			wall = 1
+		}
+
+		rates = append(rates, res.msgs*1000000000/wall)
+		putLats = append(putLats, s.putLats...)
+		getLats = append(getLats, s.getLats...)
+		res.cpu += s.cpu / 1000
+		res.wall += s.wall / 1000
+	}
+
+	res.rate = pct(rates, 50)
+	res.putP50 = pct(putLats, 50)
+	res.putP99 = pct(putLats, 99)
+	res.getP50 = pct(getLats, 50)
+	res.getP99 = pct(getLats, 99)
+	res.cpu /= int64(opts.runs)
+	res.wall /= int64(opts.runs)
+	return res
+}
+
+var COLS = []string{"impl", "workers", "buf", "msgs", "msgs_per_sec",
+	"put_p50_ns", "put_p99_ns", "get_p50_ns", "get_p99_ns",
+	"cpu_us", "wall_us"}
+
+func printRow(vals []string, opts Opts) {
+	if opts.format == "csv" {
+		fmt.Println(strings.Join(vals, ","))
+		return
+	}
+
+	for i, v := range vals {
+		if i == 0 {
+			fmt.Printf("%6s", v)
+		} else {
+			fmt.Printf("%13s", v)
+		}
+	}
+
+	fmt.Println()
+}
+
+func printResult(r Result, opts Opts) {
+	nums := []int64{int64(r.bench.workers), int64(r.bench.buf), r.msgs,
+		r.rate, r.putP50, r.putP99, r.getP50, r.getP99, r.cpu, r.wall}
+
+	if opts.format == "json" {
+		fmt.Printf("{\"%s\": \"%s\"", COLS[0], r.bench.impl)
+
+		for i, n := range nums {
+			fmt.Printf(", \"%s\": %d", COLS[i+1], n)
+		}
+
+		fmt.Println("}")
+		return
+	}
+
+	vals := []string{r.bench.impl}
+	for _, n := range nums {
+		vals = append(vals, strconv.FormatInt(n, 10))
+	}
+
+	printRow(vals, opts)
+}
+
+var (
+	WORKERS = []int{1, 2, 4}
+	BUFS    = []int{1, 10, 100, 1000}
 )
 
 func main() {
-	for workers := 1; workers < MAX_WORKERS; workers++ {
-		for reps := 10; reps < MAX_REPS; reps *= 10 {
-			for buf := 1; buf < MAX_BUF; buf *= 10 {
-				run(workers, reps, buf)
-			}
+	var opts Opts
+	flag.StringVar(&opts.format, "format", "text", "text, csv or json")
+	flag.IntVar(&opts.runs, "runs", 5, "measured runs per configuration")
+	flag.IntVar(&opts.warmup, "warmup", 1, "unmeasured runs per configuration")
+	flag.IntVar(&opts.reps, "reps", 100000, "items per worker and run")
+	flag.BoolVar(&opts.pin, "pin", false, "pin threads to cpus")
+	flag.Parse()
+
+	if opts.format != "text" && opts.format != "csv" && opts.format != "json" {
+		fmt.Fprintf(os.Stderr, "Invalid format: %s\n", opts.format)
+		os.Exit(-1)
+	}
+
+	if opts.runs < 1 {
+		opts.runs = 1
+	}
+
+	if opts.reps < 1 {
+		opts.reps = 1
+	}
+
+	if opts.format != "json" {
+		printRow(COLS, opts)
+	}
+
+	for _, workers := range WORKERS {
+		for _, buf := range BUFS {
+			printResult(bench(Bench{"go", workers, buf}, opts), opts)
 		}
 	}
 }
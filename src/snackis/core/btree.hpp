@@ -0,0 +1,441 @@
+#ifndef SNACKIS_BTREE_HPP
+#define SNACKIS_BTREE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace snackis {
+  // B+tree with items stored in linked leaves of up to ORDER entries,
+  // items move between leaves as the tree changes and emptied leaves are
+  // dropped rather than merged
+  template <typename K, typename V, size_t ORDER=64>
+  struct BTree {
+    using value_type = std::pair<K, V>;
+
+    struct Node {
+      const bool leaf;
+      std::vector<K> keys;
+      std::vector<Node *> children;
+      std::vector<value_type> items;
+      Node *prev, *next;
+
+      Node(bool leaf);
+    };
+
+    template <typename ItemT>
+    struct Iter {
+      using iterator_category = std::bidirectional_iterator_tag;
+      using value_type = ItemT;
+      using difference_type = std::ptrdiff_t;
+      using pointer = ItemT *;
+      using reference = ItemT &;
+
+      const BTree *tree;
+      Node *node;
+      size_t i;
+
+      Iter();
+      Iter(const BTree *tree, Node *node, size_t i);
+      Iter(const Iter<typename BTree::value_type> &src);
+      ItemT &operator *() const;
+      ItemT *operator ->() const;
+      Iter &operator ++();
+      Iter operator ++(int);
+      Iter &operator --();
+      Iter operator --(int);
+      bool operator ==(const Iter &other) const;
+      bool operator !=(const Iter &other) const;
+    };
+
+    using iterator = Iter<value_type>;
+    using const_iterator = Iter<const value_type>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using Path = std::vector<std::pair<Node *, size_t>>;
+
+    Node *root, *first, *last;
+    size_t count;
+
+    BTree();
+    BTree(const BTree &) = delete;
+    ~BTree();
+    BTree &operator =(const BTree &) = delete;
+
+    size_t size() const;
+    bool empty() const;
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    reverse_iterator rbegin();
+    reverse_iterator rend();
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator rend() const;
+    iterator find(const K &key);
+    const_iterator find(const K &key) const;
+    iterator lower_bound(const K &key);
+    const_iterator lower_bound(const K &key) const;
+
+    template <typename VArg>
+    std::pair<iterator, bool> emplace(const K &key, VArg &&val);
+
+    size_t erase(const K &key);
+    void erase(iterator it);
+    void clear();
+  };
+
+  template <typename K, typename V, size_t ORDER>
+  BTree<K, V, ORDER>::Node::Node(bool leaf):
+    leaf(leaf), prev(nullptr), next(nullptr) {
+    if (leaf) {
+      items.reserve(ORDER+1);
+    } else {
+      keys.reserve(ORDER);
+      children.reserve(ORDER+1);
+    }
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  template <typename ItemT>
+  BTree<K, V, ORDER>::Iter<ItemT>::Iter():
+    tree(nullptr), node(nullptr), i(0)
+  { }
+
+  template <typename K, typename V, size_t ORDER>
+  template <typename ItemT>
+  BTree<K, V, ORDER>::Iter<ItemT>::Iter(const BTree *tree, Node *node, size_t i):
+    tree(tree), node(node), i(i)
+  { }
+
+  template <typename K, typename V, size_t ORDER>
+  template <typename ItemT>
+  BTree<K, V, ORDER>::Iter<ItemT>::Iter(const Iter<typename BTree::value_type> &src):
+    tree(src.tree), node(src.node), i(src.i)
+  { }
+
+  template <typename K, typename V, size_t ORDER>
+  template <typename ItemT>
+  ItemT &BTree<K, V, ORDER>::Iter<ItemT>::operator *() const {
+    return node->items[i];
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  template <typename ItemT>
+  ItemT *BTree<K, V, ORDER>::Iter<ItemT>::operator ->() const {
+    return &node->items[i];
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  template <typename ItemT>
+  typename BTree<K, V, ORDER>::template Iter<ItemT> &
+  BTree<K, V, ORDER>::Iter<ItemT>::operator ++() {
+    if (++i == node->items.size()) {
+      node = node->next;
+      i = 0;
+    }
+
+    return *this;
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  template <typename ItemT>
+  typename BTree<K, V, ORDER>::template Iter<ItemT>
+  BTree<K, V, ORDER>::Iter<ItemT>::operator ++(int) {
+    Iter prev(*this);
+    ++(*this);
+    return prev;
+  }
+
+  // Decrementing end moves to the last item
+  template <typename K, typename V, size_t ORDER>
+  template <typename ItemT>
+  typename BTree<K, V, ORDER>::template Iter<ItemT> &
+  BTree<K, V, ORDER>::Iter<ItemT>::operator --() {
+    if (!node || !i) {
+      node = node ? node->prev : tree->last;
+      i = node->items.size();
+    }
+
+    i--;
+    return *this;
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  template <typename ItemT>
+  typename BTree<K, V, ORDER>::template Iter<ItemT>
+  BTree<K, V, ORDER>::Iter<ItemT>::operator --(int) {
+    Iter prev(*this);
+    --(*this);
+    return prev;
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  template <typename ItemT>
+  bool BTree<K, V, ORDER>::Iter<ItemT>::operator ==(const Iter &other) const {
+    return node == other.node && i == other.i;
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  template <typename ItemT>
+  bool BTree<K, V, ORDER>::Iter<ItemT>::operator !=(const Iter &other) const {
+    return !(*this == other);
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  BTree<K, V, ORDER>::BTree():
+    root(new Node(true)), first(root), last(root), count(0)
+  { }
+
+  template <typename K, typename V, size_t ORDER>
+  void free_node(typename BTree<K, V, ORDER>::Node *n) {
+    for (auto c: n->children) { free_node<K, V, ORDER>(c); }
+    delete n;
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  BTree<K, V, ORDER>::~BTree() { free_node<K, V, ORDER>(root); }
+
+  template <typename K, typename V, size_t ORDER>
+  size_t BTree<K, V, ORDER>::size() const { return count; }
+
+  template <typename K, typename V, size_t ORDER>
+  bool BTree<K, V, ORDER>::empty() const { return !count; }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::iterator BTree<K, V, ORDER>::begin() {
+    return count ? iterator(this, first, 0) : end();
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::iterator BTree<K, V, ORDER>::end() {
+    return iterator(this, nullptr, 0);
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::const_iterator BTree<K, V, ORDER>::begin() const {
+    return count ? const_iterator(this, first, 0) : end();
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::const_iterator BTree<K, V, ORDER>::end() const {
+    return const_iterator(this, nullptr, 0);
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::reverse_iterator BTree<K, V, ORDER>::rbegin() {
+    return reverse_iterator(end());
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::reverse_iterator BTree<K, V, ORDER>::rend() {
+    return reverse_iterator(begin());
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::const_reverse_iterator
+  BTree<K, V, ORDER>::rbegin() const {
+    return const_reverse_iterator(end());
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::const_reverse_iterator
+  BTree<K, V, ORDER>::rend() const {
+    return const_reverse_iterator(begin());
+  }
+
+  // Returns the leaf where key belongs, recording inner nodes and child
+  // indexes on the way down in path
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::Node *
+  find_leaf(const BTree<K, V, ORDER> &t,
+	    const K &key,
+	    typename BTree<K, V, ORDER>::Path *path=nullptr) {
+    auto n(t.root);
+
+    while (!n->leaf) {
+      const size_t i(std::upper_bound(n->keys.begin(), n->keys.end(), key) -
+		     n->keys.begin());
+      if (path) { path->emplace_back(n, i); }
+      n = n->children[i];
+    }
+
+    return n;
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  size_t leaf_index(const typename BTree<K, V, ORDER>::Node &n, const K &key) {
+    return std::lower_bound(n.items.begin(), n.items.end(), key,
+			    [](auto &it, auto &k) { return it.first < k; }) -
+      n.items.begin();
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::iterator
+  BTree<K, V, ORDER>::find(const K &key) {
+    auto n(find_leaf(*this, key));
+    const size_t i(leaf_index<K, V, ORDER>(*n, key));
+    if (i == n->items.size() || key < n->items[i].first) { return end(); }
+    return iterator(this, n, i);
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::const_iterator
+  BTree<K, V, ORDER>::find(const K &key) const {
+    return const_cast<BTree *>(this)->find(key);
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::iterator
+  BTree<K, V, ORDER>::lower_bound(const K &key) {
+    auto n(find_leaf(*this, key));
+    const size_t i(leaf_index<K, V, ORDER>(*n, key));
+    if (i < n->items.size()) { return iterator(this, n, i); }
+    return iterator(this, n->next, 0);
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::const_iterator
+  BTree<K, V, ORDER>::lower_bound(const K &key) const {
+    return const_cast<BTree *>(this)->lower_bound(key);
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  void insert_child(BTree<K, V, ORDER> &t,
+		    typename BTree<K, V, ORDER>::Path &path,
+		    const K &key,
+		    typename BTree<K, V, ORDER>::Node *child) {
+    using Node = typename BTree<K, V, ORDER>::Node;
+
+    if (path.empty()) {
+      auto r(new Node(false));
+      r->keys.push_back(key);
+      r->children.push_back(t.root);
+      r->children.push_back(child);
+      t.root = r;
+      return;
+    }
+
+    auto [n, i] = path.back();
+    path.pop_back();
+    n->keys.insert(n->keys.begin()+i, key);
+    n->children.insert(n->children.begin()+i+1, child);
+    if (n->children.size() <= ORDER) { return; }
+
+    const size_t mid(n->keys.size() / 2);
+    auto r(new Node(false));
+    const K sep(n->keys[mid]);
+    r->keys.assign(n->keys.begin()+mid+1, n->keys.end());
+    r->children.assign(n->children.begin()+mid+1, n->children.end());
+    n->keys.resize(mid);
+    n->children.resize(mid+1);
+    insert_child(t, path, sep, r);
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  template <typename VArg>
+  std::pair<typename BTree<K, V, ORDER>::iterator, bool>
+  BTree<K, V, ORDER>::emplace(const K &key, VArg &&val) {
+    Path path;
+    auto n(find_leaf(*this, key, &path));
+    size_t i(leaf_index<K, V, ORDER>(*n, key));
+
+    if (i < n->items.size() && !(key < n->items[i].first)) {
+      return std::make_pair(iterator(this, n, i), false);
+    }
+
+    n->items.emplace(n->items.begin()+i, key, std::forward<VArg>(val));
+    count++;
+
+    if (n->items.size() > ORDER) {
+      const size_t mid(n->items.size() / 2);
+      auto r(new Node(true));
+      std::move(n->items.begin()+mid, n->items.end(),
+		std::back_inserter(r->items));
+      n->items.erase(n->items.begin()+mid, n->items.end());
+      r->prev = n;
+      r->next = n->next;
+      (n->next ? n->next->prev : last) = r;
+      n->next = r;
+      insert_child(*this, path, r->items.front().first, r);
+
+      if (i >= mid) {
+	n = r;
+	i -= mid;
+      }
+    }
+
+    return std::make_pair(iterator(this, n, i), true);
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  void remove_child(BTree<K, V, ORDER> &t, typename BTree<K, V, ORDER>::Path &path) {
+    auto [n, i] = path.back();
+    path.pop_back();
+    n->children.erase(n->children.begin()+i);
+    if (!n->keys.empty()) { n->keys.erase(n->keys.begin() + (i ? i-1 : 0)); }
+    if (!n->children.empty() || path.empty()) { return; }
+    delete n;
+    remove_child(t, path);
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  size_t BTree<K, V, ORDER>::erase(const K &key) {
+    Path path;
+    auto n(find_leaf(*this, key, &path));
+    const size_t i(leaf_index<K, V, ORDER>(*n, key));
+    if (i == n->items.size() || key < n->items[i].first) { return 0; }
+    n->items.erase(n->items.begin()+i);
+    count--;
+
+    if (n->items.empty() && n != root) {
+      (n->prev ? n->prev->next : first) = n->next;
+      (n->next ? n->next->prev : last) = n->prev;
+      delete n;
+      remove_child(*this, path);
+
+      while (!root->leaf && root->children.size() < 2) {
+	auto r(root);
+
+	if (r->children.empty()) {
+	  root = first = last = new Node(true);
+	} else {
+	  root = r->children.front();
+	}
+
+	delete r;
+      }
+    }
+
+    return 1;
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  void BTree<K, V, ORDER>::erase(iterator it) {
+    const K key(it->first);
+    erase(key);
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  void BTree<K, V, ORDER>::clear() {
+    free_node<K, V, ORDER>(root);
+    root = first = last = new Node(true);
+    count = 0;
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  void copy(BTree<K, V, ORDER> &dest, const BTree<K, V, ORDER> &src) {
+    dest.clear();
+    for (auto &it: src) { dest.emplace(it.first, it.second); }
+  }
+
+  template <typename K, typename V, size_t ORDER>
+  typename BTree<K, V, ORDER>::value_type &
+  mut(BTree<K, V, ORDER> &t, typename BTree<K, V, ORDER>::iterator it) {
+    return *it;
+  }
+}
+
+#endif
@@ -1,94 +1,471 @@
 #ifndef SNACKIS_CHAN_HPP
 #define SNACKIS_CHAN_HPP
 
+#include <algorithm>
 #include <atomic>
-#include <condition_variable>
-#include <deque>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <iterator>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include "snackis/core/error.hpp"
+#include "snackis/core/futex.hpp"
 
-namespace snackis {  
-  template <typename T>
+namespace snackis {
+  const size_t CACHE_LINE(64);
+
+  // Number of threads putting or getting concurrently
+  enum ChanCard {CHAN_SINGLE, CHAN_MULTI};
+  
+  // Bounded lock free ring of max slots, each slot carries a sequence
+  // number telling producers and consumers whose turn it is; blocked
+  // threads yield for a while and then sleep on a futex.
+  // Slots at position pos are free for producers at 2*pos and ready for
+  // consumers at 2*pos+1, which keeps single slot rings unambiguous.
+  // Single sides claim positions without CAS, single producer single
+  // consumer rings skip sequence numbers and only read the opposite index
+  // when their cached copy says the ring is full or empty.
+  template <typename T, ChanCard P=CHAN_MULTI, ChanCard C=CHAN_MULTI>
   struct Chan {
+    static constexpr bool spsc = P == CHAN_SINGLE && C == CHAN_SINGLE;
+    
+    struct Slot {
+      std::atomic<size_t> seq;
+      std::aligned_storage_t<sizeof(T), alignof(T)> val;
+    };
+
     const size_t max;
-    std::deque<T> buf;
-    std::atomic<size_t> size;
-    std::mutex mutex;
-    std::condition_variable get_ok, put_ok;
-    bool closed;
+    std::unique_ptr<Slot[]> slots;
+    alignas(CACHE_LINE) std::atomic<size_t> head;
+    size_t tail_cache;
+    alignas(CACHE_LINE) std::atomic<size_t> tail;
+    size_t head_cache;
+    alignas(CACHE_LINE) Futex get_ok, put_ok;
+    std::atomic<size_t> get_waiting, put_waiting;
+    std::atomic<bool> closed;
+    // Futexes of selects waiting for items, woken along with getters
+    std::mutex watch_mutex;
+    std::vector<Futex *> watchers;
 
     Chan(size_t max);
+    Chan(const Chan &) = delete;
+    ~Chan();
+    Chan &operator =(const Chan &) = delete;
   };
 
-  using ChanLock = std::unique_lock<std::mutex>;
-  
   const int CHAN_RETRIES(10);
 
-  template <typename T>
-  Chan<T>::Chan(size_t max):
-    max(max), size(0), closed(false)
-  { }
+  template <typename T, ChanCard P, ChanCard C>
+  Chan<T, P, C>::Chan(size_t max):
+    max(max), slots(new Slot[max]), head(0), tail_cache(0), tail(0),
+    head_cache(0), get_ok(0), put_ok(0),
+    get_waiting(0), put_waiting(0), closed(false) {
+    CHECK(max, _ > 0);
+    for (size_t i(0); i < max; i++) { slots[i].seq.store(2*i); }
+  }
 
-  template <typename T>
-  void close(Chan<T> &c) {    
-    ChanLock lock(c.mutex);
-    CHECK(c.closed, !_);
-    c.closed = true;
-    c.get_ok.notify_all();
-    c.put_ok.notify_all();
+  template <typename T, ChanCard P, ChanCard C>
+  Chan<T, P, C>::~Chan() {
+    for (size_t i(head.load()); i != tail.load(); i++) {
+      reinterpret_cast<T *>(&slots[i % max].val)->~T();
+    }
   }
 
-  template <typename T>
-  bool put(Chan<T> &c, const T &it, bool wait=true) {
-    if (c.size.load() == c.max) {
-      if (!wait) { return false; }
-      int i(0);
+  // Wakes up to n sleepers on f if there are any, the fence pairs with
+  // the one in park to make sure sleepers either see the change or get woken
+  inline bool notify(Futex &f, const std::atomic<size_t> &waiting,
+		     size_t n=1) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!waiting.load(std::memory_order_relaxed)) { return false; }
+    f++;
+    wake(f, int(std::min<size_t>(n, INT_MAX)));
+    return true;
+  }
 
-      do { 
-	std::this_thread::yield();
-	i++;
-      } while (c.size.load() == c.max && i <= CHAN_RETRIES);
-    }
+  template <typename T, ChanCard P, ChanCard C>
+  void wake_watchers(Chan<T, P, C> &c) {
+    std::lock_guard<std::mutex> lock(c.watch_mutex);
     
-    ChanLock lock(c.mutex);
-    if (c.closed) { return false; }
+    for (auto f: c.watchers) {
+      (*f)++;
+      wake(*f, 1);
+    }
+  }
+  
+  template <typename T, ChanCard P, ChanCard C>
+  void notify_get(Chan<T, P, C> &c, size_t n=1) {
+    if (notify(c.get_ok, c.get_waiting, n)) { wake_watchers(c); }
+  }
 
-    if (wait && c.buf.size() == c.max) {
-      c.put_ok.wait(lock, [&c](){ return c.closed || c.buf.size() < c.max; });
+  // Registers f to be woken when items arrive or c is closed, watchers
+  // count as waiting getters
+  template <typename T, ChanCard P, ChanCard C>
+  void watch(Chan<T, P, C> &c, Futex &f) {
+    {
+      std::lock_guard<std::mutex> lock(c.watch_mutex);
+      c.watchers.push_back(&f);
     }
 
-    if (c.buf.size() == c.max) { return false; }
-    c.buf.push_back(it);
-    c.size++;
-    c.get_ok.notify_one();
-    return true;
+    c.get_waiting++;
   }
 
-  template <typename T>
-  opt<T> get(Chan<T> &c, bool wait=true) {
-    if (c.size.load() == 0) {
-      if (!wait) { return nullopt; }
-      int i(0);
+  template <typename T, ChanCard P, ChanCard C>
+  void unwatch(Chan<T, P, C> &c, Futex &f) {
+    c.get_waiting--;
+    std::lock_guard<std::mutex> lock(c.watch_mutex);
+    c.watchers.erase(std::find(c.watchers.begin(), c.watchers.end(), &f));
+  }
 
-      do { 
-	std::this_thread::yield(); 
-	i++;
-      } while (c.size.load() == 0 && i <= CHAN_RETRIES);
+  // Sleeps on f unless ready, yields to let threads in the middle of
+  // claiming slots finish otherwise
+  template <typename PredT>
+  void park(Futex &f, std::atomic<size_t> &waiting, const PredT &ready,
+	    const opt<std::chrono::nanoseconds> &timeout=nullopt) {
+    auto v(f.load());
+    waiting++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    
+    if (ready()) {
+      std::this_thread::yield();
+    } else {
+      wait(f, v, timeout);
     }
+    
+    waiting--;
+  }
 
-    ChanLock lock(c.mutex);
+  // Returns true unless get would block, might be true while items are
+  // still being put
+  template <typename T, ChanCard P, ChanCard C>
+  bool get_ready(const Chan<T, P, C> &c) {
+    return c.closed.load() || c.head.load() != c.tail.load();
+  }
+
+  template <typename T, ChanCard P, ChanCard C>
+  void close(Chan<T, P, C> &c) {
+    CHECK(c.closed.exchange(true), !_);
+    c.get_ok++;
+    c.put_ok++;
+    wake_all(c.get_ok);
+    wake_all(c.put_ok);
+    wake_watchers(c);
+  }
+
+  template <typename T, ChanCard P, ChanCard C, typename U>
+  bool try_put(Chan<T, P, C> &c, U &&it) {
+    auto pos(c.tail.load(std::memory_order_relaxed));
+    auto s(&c.slots[pos % c.max]);
+    
+    if constexpr (Chan<T, P, C>::spsc) {
+      if (pos - c.head_cache == c.max) {
+	c.head_cache = c.head.load(std::memory_order_acquire);
+	if (pos - c.head_cache == c.max) { return false; }
+      }
+
+      new (&s->val) T(std::forward<U>(it));
+      c.tail.store(pos+1, std::memory_order_release);
+    } else {
+      while (true) {
+	auto diff(intptr_t(s->seq.load(std::memory_order_acquire)) -
+		  intptr_t(2*pos));
+	
+	if (diff == 0) {
+	  if constexpr (P == CHAN_SINGLE) {
+	    c.tail.store(pos+1, std::memory_order_relaxed);
+	    break;
+	  } else if (c.tail.compare_exchange_weak(pos, pos+1,
+						  std::memory_order_relaxed)) {
+	    break;
+	  }
+	} else if (diff < 0) {
+	  return false;
+	} else {
+	  pos = c.tail.load(std::memory_order_relaxed);
+	}
+
+	s = &c.slots[pos % c.max];
+      }
+      
+      new (&s->val) T(std::forward<U>(it));
+      s->seq.store(2*pos+1, std::memory_order_release);
+    }
+    
+    notify_get(c);
+    return true;
+  }
+
+  template <typename T, ChanCard P, ChanCard C>
+  opt<T> try_get(Chan<T, P, C> &c) {
+    auto pos(c.head.load(std::memory_order_relaxed));
+    auto s(&c.slots[pos % c.max]);
+
+    if constexpr (Chan<T, P, C>::spsc) {
+      if (pos == c.tail_cache) {
+	c.tail_cache = c.tail.load(std::memory_order_acquire);
+	if (pos == c.tail_cache) { return nullopt; }
+      }
+    } else {
+      while (true) {
+	auto diff(intptr_t(s->seq.load(std::memory_order_acquire)) -
+		  intptr_t(2*pos+1));
+	
+	if (diff == 0) {
+	  if constexpr (C == CHAN_SINGLE) {
+	    c.head.store(pos+1, std::memory_order_relaxed);
+	    break;
+	  } else if (c.head.compare_exchange_weak(pos, pos+1,
+						  std::memory_order_relaxed)) {
+	    break;
+	  }
+	} else if (diff < 0) {
+	  return nullopt;
+	} else {
+	  pos = c.head.load(std::memory_order_relaxed);
+	}
+
+	s = &c.slots[pos % c.max];
+      }
+    }
     
-    if (wait && c.buf.empty()) {
-      c.get_ok.wait(lock, [&c](){ return c.closed || !c.buf.empty(); });
+    auto &v(*reinterpret_cast<T *>(&s->val));
+    opt<T> out(std::move(v));
+    v.~T();
+
+    if constexpr (Chan<T, P, C>::spsc) {
+      c.head.store(pos+1, std::memory_order_release);
+    } else {
+      s->seq.store(2*(pos + c.max), std::memory_order_release);
     }
     
-    if (c.buf.empty()) { return nullopt; }
-    auto out(c.buf.front());
-    c.buf.pop_front();
-    c.size--;
-    c.put_ok.notify_one();
+    notify(c.put_ok, c.put_waiting);
     return out;
   }
+
+  // Puts as many items from [beg, end) as there is room for, claiming
+  // slots once; move iterators move items in
+  template <typename T, ChanCard P, ChanCard C, typename IterT>
+  size_t try_put_all(Chan<T, P, C> &c, IterT beg, IterT end) {
+    size_t n(std::distance(beg, end));
+    if (!n) { return 0; }
+    auto pos(c.tail.load(std::memory_order_relaxed));
+    
+    if constexpr (Chan<T, P, C>::spsc) {
+      if (c.max - (pos - c.head_cache) < n) {
+	c.head_cache = c.head.load(std::memory_order_acquire);
+      }
+
+      n = std::min(n, c.max - (pos - c.head_cache));
+      if (!n) { return 0; }
+      
+      for (size_t i(0); i < n; i++, beg++) {
+	new (&c.slots[(pos+i) % c.max].val) T(*beg);
+      }
+      
+      c.tail.store(pos+n, std::memory_order_release);
+    } else {
+      while (true) {
+	size_t k(0);
+	
+	while (k < n && c.slots[(pos+k) % c.max].seq.load(
+	         std::memory_order_acquire) == 2*(pos+k)) {
+	  k++;
+	}
+	
+	if (!k) {
+	  auto &s(c.slots[pos % c.max]);
+	  if (intptr_t(s.seq.load(std::memory_order_acquire)) <
+	      intptr_t(2*pos)) { return 0; }
+	  pos = c.tail.load(std::memory_order_relaxed);
+	  continue;
+	}
+
+	n = k;
+	
+	if constexpr (P == CHAN_SINGLE) {
+	  c.tail.store(pos+n, std::memory_order_relaxed);
+	  break;
+	} else if (c.tail.compare_exchange_weak(pos, pos+n,
+						std::memory_order_relaxed)) {
+	  break;
+	}
+      }
+
+      for (size_t i(0); i < n; i++, beg++) {
+	auto &s(c.slots[(pos+i) % c.max]);
+	new (&s.val) T(*beg);
+	s.seq.store(2*(pos+i)+1, std::memory_order_release);
+      }
+    }
+
+    notify_get(c, n);
+    return n;
+  }
+
+  // Moves up to max items to the end of out, releasing slots once
+  template <typename T, ChanCard P, ChanCard C>
+  size_t try_drain(Chan<T, P, C> &c, std::vector<T> &out, size_t max) {
+    if (!max) { return 0; }
+    auto pos(c.head.load(std::memory_order_relaxed));
+    size_t n(0);
+    
+    if constexpr (Chan<T, P, C>::spsc) {
+      if (c.tail_cache - pos < max) {
+	c.tail_cache = c.tail.load(std::memory_order_acquire);
+      }
+
+      n = std::min(max, c.tail_cache - pos);
+      if (!n) { return 0; }
+    } else {
+      while (true) {
+	n = 0;
+	
+	while (n < max && c.slots[(pos+n) % c.max].seq.load(
+	         std::memory_order_acquire) == 2*(pos+n)+1) {
+	  n++;
+	}
+	
+	if (!n) {
+	  auto &s(c.slots[pos % c.max]);
+	  if (intptr_t(s.seq.load(std::memory_order_acquire)) <
+	      intptr_t(2*pos+1)) { return 0; }
+	  pos = c.head.load(std::memory_order_relaxed);
+	  continue;
+	}
+
+	if constexpr (C == CHAN_SINGLE) {
+	  c.head.store(pos+n, std::memory_order_relaxed);
+	  break;
+	} else if (c.head.compare_exchange_weak(pos, pos+n,
+						std::memory_order_relaxed)) {
+	  break;
+	}
+      }
+    }
+
+    out.reserve(out.size() + n);
+    
+    for (size_t i(0); i < n; i++) {
+      auto &s(c.slots[(pos+i) % c.max]);
+      auto &v(*reinterpret_cast<T *>(&s.val));
+      out.push_back(std::move(v));
+      v.~T();
+      
+      if constexpr (!Chan<T, P, C>::spsc) {
+	s.seq.store(2*(pos+i+c.max), std::memory_order_release);
+      }
+    }
+
+    if constexpr (Chan<T, P, C>::spsc) {
+      c.head.store(pos+n, std::memory_order_release);
+    }
+    
+    notify(c.put_ok, c.put_waiting, n);
+    return n;
+  }
+
+  template <typename T, ChanCard P, ChanCard C>
+  void wait_put(Chan<T, P, C> &c, int retries) {
+    if (retries < CHAN_RETRIES) {
+      std::this_thread::yield();
+    } else {
+      park(c.put_ok, c.put_waiting, [&c]() {
+	  return c.closed.load() || c.tail.load() - c.head.load() < c.max;
+	});
+    }
+  }
+  
+  template <typename T, ChanCard P, ChanCard C>
+  void wait_get(Chan<T, P, C> &c, int retries) {
+    if (retries < CHAN_RETRIES) {
+      std::this_thread::yield();
+    } else {
+      park(c.get_ok, c.get_waiting, [&c]() {
+	  return get_ready(c);
+	});
+    }
+  }
+
+  template <typename T, ChanCard P, ChanCard C, typename U>
+  bool put(Chan<T, P, C> &c, U &&it, bool wait=true) {
+    for (int i(0);; i++) {
+      if (c.closed.load()) { return false; }
+      if (try_put(c, std::forward<U>(it))) { return true; }
+      if (!wait) { return false; }
+      wait_put(c, i);
+    }
+  }
+
+  // Returns the number of items put, which is less than requested if
+  // the channel was closed or not waiting and full
+  template <typename T, ChanCard P, ChanCard C, typename IterT>
+  size_t put_all(Chan<T, P, C> &c, IterT beg, IterT end, bool wait=true) {
+    size_t n(0);
+    
+    for (int i(0); beg != end; i++) {
+      if (c.closed.load()) { break; }
+      auto k(try_put_all(c, beg, end));
+      
+      if (k) {
+	std::advance(beg, k);
+	n += k;
+	i = -1;
+	continue;
+      }
+      
+      if (!wait) { break; }
+      wait_put(c, i);
+    }
+
+    return n;
+  }
+
+  // Items put before closing are still delivered, nullopt is returned
+  // once the channel is closed and empty
+  template <typename T, ChanCard P, ChanCard C>
+  opt<T> get(Chan<T, P, C> &c, bool wait=true) {
+    for (int i(0);; i++) {
+      auto closed(c.closed.load());
+      auto out(try_get(c));
+      if (out || closed || !wait) { return out; }
+      wait_get(c, i);
+    }
+  }
+
+  // Waits for at least one item and moves up to max available items to the
+  // end of out, returns 0 once the channel is closed and empty
+  template <typename T, ChanCard P, ChanCard C>
+  size_t drain(Chan<T, P, C> &c, std::vector<T> &out, size_t max,
+	       bool wait=true) {
+    for (int i(0);; i++) {
+      auto closed(c.closed.load());
+      auto n(try_drain(c, out, max));
+      if (n || closed || !wait) { return n; }
+      wait_get(c, i);
+    }
+  }
+
+  template <typename T, ChanCard P, ChanCard C,
+	    typename ClockT, typename DurT>
+  opt<T> get(Chan<T, P, C> &c, const std::chrono::time_point<ClockT, DurT> &deadline) {
+    while (true) {
+      auto closed(c.closed.load());
+      auto out(try_get(c));
+      if (out || closed) { return out; }
+      auto left(deadline - ClockT::now());
+      if (left.count() <= 0) { return nullopt; }
+
+      park(c.get_ok, c.get_waiting, [&c]() {
+	  return get_ready(c);
+	},
+	std::chrono::duration_cast<std::chrono::nanoseconds>(left));
+    }
+  }
 }
 
 #endif
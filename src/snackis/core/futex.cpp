@@ -0,0 +1,36 @@
+#include <algorithm>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "snackis/core/futex.hpp"
+
+namespace snackis {
+  static uint32_t *get_addr(Futex &f) {
+    static_assert(sizeof(Futex) == sizeof(uint32_t));
+    return reinterpret_cast<uint32_t *>(&f);
+  }
+  
+  void wait(Futex &f, uint32_t val,
+	    const opt<std::chrono::nanoseconds> &timeout) {
+    timespec ts;
+    
+    if (timeout) {
+      auto ns(std::max<int64_t>(timeout->count(), 0));
+      ts.tv_sec = ns / 1000000000;
+      ts.tv_nsec = ns % 1000000000;
+    }
+    
+    syscall(SYS_futex, get_addr(f), FUTEX_WAIT_PRIVATE, val,
+	    timeout ? &ts : nullptr, nullptr, 0);
+  }
+
+  void wake(Futex &f, int n) {
+    syscall(SYS_futex, get_addr(f), FUTEX_WAKE_PRIVATE, n,
+	    nullptr, nullptr, 0);
+  }
+
+  void wake_all(Futex &f) { wake(f, INT_MAX); }
+}
@@ -0,0 +1,22 @@
+#ifndef SNACKIS_FUTEX_HPP
+#define SNACKIS_FUTEX_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "snackis/core/opt.hpp"
+
+namespace snackis {
+  using Futex = std::atomic<uint32_t>;
+  
+  // Sleeps while f equals val, until woken or timeout has passed;
+  // returns immediately if f was changed before
+  void wait(Futex &f, uint32_t val,
+	    const opt<std::chrono::nanoseconds> &timeout=nullopt);
+
+  void wake(Futex &f, int n);
+  void wake_all(Futex &f);
+}
+
+#endif
@@ -0,0 +1,324 @@
+#ifndef SNACKIS_HASH_MAP_HPP
+#define SNACKIS_HASH_MAP_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace snackis {
+  // Open addressing with linear probing, items are allocated separately to
+  // keep their addresses stable until erased; copies share items, which
+  // are cloned by mut() before being modified
+  template <typename K, typename V, typename HashT>
+  struct HashMap {
+    using value_type = std::pair<const K, V>;
+
+    struct Node {
+      std::atomic<size_t> refs;
+      value_type item;
+
+      template <typename VArg>
+      Node(const K &key, VArg &&val);
+    };
+    
+    struct Slot {
+      size_t hash;
+      Node *node;
+    };
+
+    template <typename ItemT>
+    struct Iter {
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = ItemT;
+      using difference_type = std::ptrdiff_t;
+      using pointer = ItemT *;
+      using reference = ItemT &;
+
+      const Slot *slot, *end;
+
+      Iter(const Slot *slot, const Slot *end);
+      Iter(const Iter<typename HashMap::value_type> &src);
+      ItemT &operator *() const;
+      ItemT *operator ->() const;
+      Iter &operator ++();
+      Iter operator ++(int);
+      bool operator ==(const Iter &other) const;
+      bool operator !=(const Iter &other) const;
+    };
+
+    using iterator = Iter<value_type>;
+    using const_iterator = Iter<const value_type>;
+
+    std::vector<Slot> slots;
+    size_t count;
+    int bits;
+    HashT hasher;
+
+    HashMap();
+    HashMap(const HashMap &) = delete;
+    ~HashMap();
+    HashMap &operator =(const HashMap &) = delete;
+
+    size_t size() const;
+    bool empty() const;
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    iterator find(const K &key);
+    const_iterator find(const K &key) const;
+
+    template <typename VArg>
+    std::pair<iterator, bool> emplace(const K &key, VArg &&val);
+
+    size_t erase(const K &key);
+    void erase(iterator it);
+    void clear();
+  };
+
+  template <typename K, typename V, typename HashT>
+  template <typename VArg>
+  HashMap<K, V, HashT>::Node::Node(const K &key, VArg &&val):
+    refs(1), item(key, std::forward<VArg>(val))
+  { }
+
+  template <typename K, typename V, typename HashT>
+  template <typename ItemT>
+  HashMap<K, V, HashT>::Iter<ItemT>::Iter(const Slot *slot, const Slot *end):
+    slot(slot), end(end) {
+    while (this->slot != end && !this->slot->node) { this->slot++; }
+  }
+
+  template <typename K, typename V, typename HashT>
+  template <typename ItemT>
+  HashMap<K, V, HashT>::Iter<ItemT>::Iter(const Iter<typename HashMap::value_type> &src):
+    slot(src.slot), end(src.end)
+  { }
+
+  template <typename K, typename V, typename HashT>
+  template <typename ItemT>
+  ItemT &HashMap<K, V, HashT>::Iter<ItemT>::operator *() const {
+    return slot->node->item;
+  }
+
+  template <typename K, typename V, typename HashT>
+  template <typename ItemT>
+  ItemT *HashMap<K, V, HashT>::Iter<ItemT>::operator ->() const {
+    return &slot->node->item;
+  }
+
+  template <typename K, typename V, typename HashT>
+  template <typename ItemT>
+  typename HashMap<K, V, HashT>::template Iter<ItemT> &
+  HashMap<K, V, HashT>::Iter<ItemT>::operator ++() {
+    do { slot++; } while (slot != end && !slot->node);
+    return *this;
+  }
+
+  template <typename K, typename V, typename HashT>
+  template <typename ItemT>
+  typename HashMap<K, V, HashT>::template Iter<ItemT>
+  HashMap<K, V, HashT>::Iter<ItemT>::operator ++(int) {
+    Iter prev(*this);
+    ++(*this);
+    return prev;
+  }
+
+  template <typename K, typename V, typename HashT>
+  template <typename ItemT>
+  bool HashMap<K, V, HashT>::Iter<ItemT>::operator ==(const Iter &other) const {
+    return slot == other.slot;
+  }
+
+  template <typename K, typename V, typename HashT>
+  template <typename ItemT>
+  bool HashMap<K, V, HashT>::Iter<ItemT>::operator !=(const Iter &other) const {
+    return slot != other.slot;
+  }
+
+  template <typename K, typename V, typename HashT>
+  HashMap<K, V, HashT>::HashMap():
+    count(0), bits(0)
+  { }
+
+  template <typename K, typename V, typename HashT>
+  HashMap<K, V, HashT>::~HashMap() { clear(); }
+
+  template <typename K, typename V, typename HashT>
+  size_t HashMap<K, V, HashT>::size() const { return count; }
+
+  template <typename K, typename V, typename HashT>
+  bool HashMap<K, V, HashT>::empty() const { return !count; }
+
+  template <typename K, typename V, typename HashT>
+  typename HashMap<K, V, HashT>::iterator HashMap<K, V, HashT>::begin() {
+    return iterator(slots.data(), slots.data()+slots.size());
+  }
+
+  template <typename K, typename V, typename HashT>
+  typename HashMap<K, V, HashT>::iterator HashMap<K, V, HashT>::end() {
+    return iterator(slots.data()+slots.size(), slots.data()+slots.size());
+  }
+
+  template <typename K, typename V, typename HashT>
+  typename HashMap<K, V, HashT>::const_iterator HashMap<K, V, HashT>::begin() const {
+    return const_iterator(slots.data(), slots.data()+slots.size());
+  }
+
+  template <typename K, typename V, typename HashT>
+  typename HashMap<K, V, HashT>::const_iterator HashMap<K, V, HashT>::end() const {
+    return const_iterator(slots.data()+slots.size(), slots.data()+slots.size());
+  }
+
+  // Fibonacci hashing spreads weak hashes over the high bits
+  template <typename K, typename V, typename HashT>
+  size_t home(const HashMap<K, V, HashT> &m, size_t hash) {
+    return (uint64_t(hash) * 0x9e3779b97f4a7c15ULL) >> (64 - m.bits);
+  }
+
+  template <typename K, typename V, typename HashT>
+  size_t find_slot(const HashMap<K, V, HashT> &m, const K &key, size_t hash) {
+    const size_t mask(m.slots.size()-1);
+
+    for (size_t i(home(m, hash)); m.slots[i].node; i = (i+1) & mask) {
+      auto &s(m.slots[i]);
+      if (s.hash == hash && s.node->item.first == key) { return i; }
+    }
+
+    return m.slots.size();
+  }
+
+  template <typename K, typename V, typename HashT>
+  typename HashMap<K, V, HashT>::iterator
+  HashMap<K, V, HashT>::find(const K &key) {
+    if (!count) { return end(); }
+    const size_t i(find_slot(*this, key, hasher(key)));
+    return iterator(slots.data()+i, slots.data()+slots.size());
+  }
+
+  template <typename K, typename V, typename HashT>
+  typename HashMap<K, V, HashT>::const_iterator
+  HashMap<K, V, HashT>::find(const K &key) const {
+    if (!count) { return end(); }
+    const size_t i(find_slot(*this, key, hasher(key)));
+    return const_iterator(slots.data()+i, slots.data()+slots.size());
+  }
+
+  template <typename K, typename V, typename HashT>
+  void put_slot(HashMap<K, V, HashT> &m, const typename HashMap<K, V, HashT>::Slot &s) {
+    const size_t mask(m.slots.size()-1);
+    size_t i(home(m, s.hash));
+    while (m.slots[i].node) { i = (i+1) & mask; }
+    m.slots[i] = s;
+  }
+
+  template <typename K, typename V, typename HashT>
+  void grow(HashMap<K, V, HashT> &m) {
+    std::vector<typename HashMap<K, V, HashT>::Slot> prev;
+    prev.swap(m.slots);
+    m.bits = m.bits ? m.bits+1 : 3;
+    m.slots.resize(size_t(1) << m.bits, {0, nullptr});
+    for (auto &s: prev) { if (s.node) { put_slot(m, s); } }
+  }
+
+  template <typename K, typename V, typename HashT>
+  template <typename VArg>
+  std::pair<typename HashMap<K, V, HashT>::iterator, bool>
+  HashMap<K, V, HashT>::emplace(const K &key, VArg &&val) {
+    const size_t hash(hasher(key));
+
+    if (count) {
+      const size_t i(find_slot(*this, key, hash));
+
+      if (i < slots.size()) {
+	return std::make_pair(iterator(slots.data()+i, slots.data()+slots.size()),
+			      false);
+      }
+    }
+
+    // Keep load below 3/4
+    if ((count+1)*4 > slots.size()*3) { grow(*this); }
+    const size_t mask(slots.size()-1);
+    size_t i(home(*this, hash));
+    while (slots[i].node) { i = (i+1) & mask; }
+    slots[i] = {hash, new Node(key, std::forward<VArg>(val))};
+    count++;
+    return std::make_pair(iterator(slots.data()+i, slots.data()+slots.size()), true);
+  }
+
+  template <typename K, typename V, typename HashT>
+  void release(typename HashMap<K, V, HashT>::Node *n) {
+    if (n->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) { delete n; }
+  }
+  
+  // Shifts following items back instead of leaving tombstones
+  template <typename K, typename V, typename HashT>
+  void erase_slot(HashMap<K, V, HashT> &m, size_t i) {
+    const size_t mask(m.slots.size()-1);
+    release<K, V, HashT>(m.slots[i].node);
+    m.count--;
+
+    for (size_t j((i+1) & mask); m.slots[j].node; j = (j+1) & mask) {
+      const size_t k(home(m, m.slots[j].hash));
+
+      if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+	m.slots[i] = m.slots[j];
+	i = j;
+      }
+    }
+
+    m.slots[i] = {0, nullptr};
+  }
+
+  template <typename K, typename V, typename HashT>
+  size_t HashMap<K, V, HashT>::erase(const K &key) {
+    if (!count) { return 0; }
+    const size_t i(find_slot(*this, key, hasher(key)));
+    if (i == slots.size()) { return 0; }
+    erase_slot(*this, i);
+    return 1;
+  }
+
+  template <typename K, typename V, typename HashT>
+  void HashMap<K, V, HashT>::erase(iterator it) {
+    erase_slot(*this, it.slot - slots.data());
+  }
+
+  // Replaces dest with items shared with src
+  template <typename K, typename V, typename HashT>
+  void copy(HashMap<K, V, HashT> &dest, const HashMap<K, V, HashT> &src) {
+    dest.clear();
+    dest.slots = src.slots;
+    dest.count = src.count;
+    dest.bits = src.bits;
+    for (auto &s: dest.slots) { if (s.node) { s.node->refs++; } }
+  }
+
+  template <typename K, typename V, typename HashT>
+  typename HashMap<K, V, HashT>::value_type &
+  mut(HashMap<K, V, HashT> &m, typename HashMap<K, V, HashT>::iterator it) {
+    auto &n(m.slots[it.slot - m.slots.data()].node);
+
+    if (n->refs.load(std::memory_order_acquire) > 1) {
+      auto prev(n);
+      n = new typename HashMap<K, V, HashT>::Node(prev->item.first,
+						  prev->item.second);
+      release<K, V, HashT>(prev);
+    }
+
+    return n->item;
+  }
+
+  template <typename K, typename V, typename HashT>
+  void HashMap<K, V, HashT>::clear() {
+    for (auto &s: slots) { if (s.node) { release<K, V, HashT>(s.node); } }
+    slots.clear();
+    count = 0;
+    bits = 0;
+  }
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 namespace snackis {
   Int64Type int64_type;
+  thread_local bool int64_decimal(false);
 
   Int64Type::Int64Type(): Type<int64_t>("Int64")
   { }
@@ -11,19 +12,42 @@ namespace snackis {
 
   Val Int64Type::to_val(const int64_t &in) const { return in; }
 
-  int64_t Int64Type::read(std::istream &in) const {
+  static int64_t read_decimal(std::istream &in) {
     uint8_t len;
     in.read((char *)&len, sizeof len);
-    std::vector<char> data(len);
-    in.read(&data[0], len);
-    const str str_val(data.begin(), data.end());
-    return to_int64(str_val);    
+    char data[UINT8_MAX+1];
+    in.read(data, len);
+    if (in.fail()) { return 0; }
+    data[len] = 0;
+    return strtoll(data, nullptr, 10);
+  }
+  
+  int64_t Int64Type::read(std::istream &in) const {
+    if (int64_decimal) { return read_decimal(in); }
+    uint64_t val(0);
+    
+    for (int shift(0); shift < 64; shift += 7) {
+      auto c(in.get());
+      if (c == std::istream::traits_type::eof()) { return 0; }
+      val |= uint64_t(c & 0x7f) << shift;
+      if (!(c & 0x80)) { break; }
+    }
+
+    return int64_t(val >> 1) ^ -int64_t(val & 1);
   }
   
   void Int64Type::write(const int64_t &val, std::ostream &out) const {
-    const str str_val(to_str(val));
-    uint8_t len(str_val.size());
-    out.write((char *)&len, sizeof len);
-    out.write(str_val.data(), len);
+    uint64_t zz((uint64_t(val) << 1) ^ uint64_t(val >> 63));
+    char data[MAX_SIZE];
+    size_t len(0);
+    
+    do {
+      data[len] = zz & 0x7f;
+      zz >>= 7;
+      if (zz) { data[len] |= 0x80; }
+      len++;
+    } while (zz);
+
+    out.write(data, len);
   }
 }
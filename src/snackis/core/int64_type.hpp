@@ -5,7 +5,10 @@
 #include "snackis/core/type.hpp"
 
 namespace snackis {
+  // Zigzag-encoded LEB128 varints
   struct Int64Type: Type<int64_t> {
+    static const size_t MAX_SIZE = 10;
+    
     Int64Type();
     int64_t from_val(const Val &in) const override;
     Val to_val(const int64_t &in) const override;
@@ -14,6 +17,10 @@ namespace snackis {
   };
 
   extern Int64Type int64_type;
+
+  // Reads length-prefixed decimal strings as written up to db revision #3,
+  // writes are unaffected.
+  extern thread_local bool int64_decimal;
 }
 
 #endif
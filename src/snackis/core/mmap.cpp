@@ -0,0 +1,44 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snackis/core/error.hpp"
+#include "snackis/core/mmap.hpp"
+
+namespace snackis {
+  MMap::MMap(const Path &p): data(nullptr), size(0) {
+    int fd(open(p.string().c_str(), O_RDONLY));
+
+    if (fd == -1) {
+      ERROR(Core, fmt("Failed opening file: %0", p.string()));
+      return;
+    }
+
+    struct stat st;
+    
+    if (fstat(fd, &st) == -1) {
+      ERROR(Core, fmt("Failed reading file size: %0", p.string()));
+      close(fd);
+      return;
+    }
+    
+    if (st.st_size) {
+      void *ptr(mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+
+      if (ptr == MAP_FAILED) {
+	ERROR(Core, fmt("Failed mapping file: %0", p.string()));
+      } else {
+	madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+	data = static_cast<const unsigned char *>(ptr);
+	size = st.st_size;
+      }
+    }
+    
+    close(fd);
+  }
+
+  MMap::~MMap() {
+    if (data) { munmap(const_cast<unsigned char *>(data), size); }
+  }
+}
@@ -0,0 +1,18 @@
+#ifndef SNACKIS_MMAP_HPP
+#define SNACKIS_MMAP_HPP
+
+#include "snackis/core/path.hpp"
+
+namespace snackis {
+  struct MMap {
+    const unsigned char *data;
+    size_t size;
+
+    MMap(const Path &p);
+    MMap(const MMap &) = delete;
+    ~MMap();
+    MMap &operator =(const MMap &) = delete;
+  };
+}
+
+#endif
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "snackis/core/error.hpp"
+#include "snackis/core/parallel.hpp"
+#include "snackis/core/utils.hpp"
+
+namespace snackis {
+  struct ParallelJob {
+    const size_t n;
+    const func<void (size_t)> &fn;
+    std::atomic<size_t> next;
+    size_t users;
+    std::vector<std::vector<Error *>> errors;
+
+    ParallelJob(size_t n, const func<void (size_t)> &fn):
+      n(n), fn(fn), next(0), users(0), errors(n)
+    { }
+  };
+
+  // Shared by all calls and never destroyed, since threads are detached
+  struct ParallelPool {
+    std::mutex mutex;
+    std::condition_variable ready, done;
+    std::deque<ParallelJob *> jobs;
+    size_t size;
+
+    ParallelPool(): size(0) { }
+  };
+
+  static thread_local bool in_job(false);
+
+  static void run(ParallelJob &job) {
+    in_job = true;
+
+    for (size_t i(job.next++); i < job.n; i = job.next++) {
+      TRY(try_worker);
+      job.fn(i);
+      job.errors[i].swap(try_worker.errors);
+    }
+
+    in_job = false;
+  }
+
+  static void run_worker(ParallelPool &pool) {
+    std::unique_lock<std::mutex> lock(pool.mutex);
+
+    for (;;) {
+      pool.ready.wait(lock, [&pool]() { return !pool.jobs.empty(); });
+      auto job(pool.jobs.front());
+
+      if (job->next >= job->n) {
+	pool.jobs.pop_front();
+	continue;
+      }
+
+      job->users++;
+      lock.unlock();
+      run(*job);
+      lock.lock();
+      if (!--job->users) { pool.done.notify_all(); }
+    }
+  }
+
+  static ParallelPool &get_pool() {
+    static ParallelPool &pool([]() -> ParallelPool & {
+	auto p(new ParallelPool());
+	p->size = max(std::thread::hardware_concurrency(), 1) - 1;
+
+	for (size_t i(0); i < p->size; i++) {
+	  std::thread(run_worker, std::ref(*p)).detach();
+	}
+
+	return *p;
+      }());
+
+    return pool;
+  }
+
+  void parallel_for(size_t n, const func<void (size_t)> &fn) {
+    if (n < 2 || in_job || !get_pool().size) {
+      for (size_t i(0); i < n; i++) { fn(i); }
+      return;
+    }
+
+    auto &pool(get_pool());
+    ParallelJob job(n, fn);
+
+    {
+      std::unique_lock<std::mutex> lock(pool.mutex);
+      pool.jobs.push_back(&job);
+    }
+
+    pool.ready.notify_all();
+    run(job);
+
+    {
+      std::unique_lock<std::mutex> lock(pool.mutex);
+      auto i(std::find(pool.jobs.begin(), pool.jobs.end(), &job));
+      if (i != pool.jobs.end()) { pool.jobs.erase(i); }
+      pool.done.wait(lock, [&job]() { return !job.users; });
+    }
+
+    for (auto &es: job.errors) {
+      for (auto e: es) { throw_error(e); }
+    }
+  }
+}
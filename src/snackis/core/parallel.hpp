@@ -0,0 +1,14 @@
+#ifndef SNACKIS_PARALLEL_HPP
+#define SNACKIS_PARALLEL_HPP
+
+#include <cstddef>
+#include "snackis/core/func.hpp"
+
+namespace snackis {
+  // Calls fn for each index in [0, n) on the calling thread and a shared
+  // pool of hardware_concurrency-1 threads, nested calls run inline.
+  // Errors thrown in workers are rethrown in the calling Try in index order.
+  void parallel_for(size_t n, const func<void (size_t)> &fn);
+}
+
+#endif
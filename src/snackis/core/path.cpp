@@ -1,3 +1,5 @@
+#include <fcntl.h>
+#include <unistd.h>
 #include "snackis/core/path.hpp"
 
 namespace snackis {  
@@ -9,9 +11,35 @@ namespace snackis {
     return std::experimental::filesystem::exists(p);
   }
 
+  int64_t path_size(const Path &p) {
+    std::error_code e;
+    auto size(std::experimental::filesystem::file_size(p, e));
+    return e ? -1 : size;
+  }
+
   bool remove_path(const Path &p) {
     std::error_code e;
     std::experimental::filesystem::remove_all(p, e);
     return e.value() == 0;
   }
+
+  bool rename_path(const Path &from, const Path &to) {
+    std::error_code e;
+    std::experimental::filesystem::rename(from, to, e);
+    return e.value() == 0;
+  }
+
+  bool resize_path(const Path &p, int64_t size) {
+    std::error_code e;
+    std::experimental::filesystem::resize_file(p, size, e);
+    return e.value() == 0;
+  }
+
+  bool sync_path(const Path &p) {
+    int fd(open(p.string().c_str(), O_RDONLY));
+    if (fd == -1) { return false; }
+    bool ok(fsync(fd) == 0);
+    close(fd);
+    return ok;
+  }
 }
@@ -1,6 +1,7 @@
 #ifndef SNACKIS_PATH_HPP
 #define SNACKIS_PATH_HPP
 
+#include <cstdint>
 #include <experimental/filesystem>
 
 namespace snackis {
@@ -9,7 +10,11 @@ namespace snackis {
   
   bool create_path(const Path &p);
   bool path_exists(const Path &p);
+  int64_t path_size(const Path &p);
   bool remove_path(const Path &p);
+  bool rename_path(const Path &from, const Path &to);
+  bool resize_path(const Path &p, int64_t size);
+  bool sync_path(const Path &p);
 }
 
 #endif
@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <thread>
+
+#include "snackis/core/select.hpp"
+
+namespace snackis {
+  Select::Select():
+    ready(0), next(0)
+  { }
+
+  static bool try_recv(Select &s) {
+    const size_t n(s.cases.size());
+    
+    for (size_t i(0); i < n; i++) {
+      auto j((s.next + i) % n);
+      
+      if (s.cases[j].recv()) {
+	s.next = (j+1) % n;
+	return true;
+      }
+    }
+
+    return false;
+  }
+  
+  bool select(Select &s,
+	      const opt<std::chrono::steady_clock::time_point> &deadline) {
+    using Clock = std::chrono::steady_clock;
+    
+    for (int i(0);; i++) {
+      if (try_recv(s)) { return true; }
+      if (deadline && Clock::now() >= *deadline) { return false; }
+      
+      if (i < CHAN_RETRIES) {
+	std::this_thread::yield();
+	continue;
+      }
+      
+      auto v(s.ready.load());
+      for (auto &c: s.cases) { c.watch(s.ready); }
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      
+      if (std::none_of(s.cases.begin(), s.cases.end(),
+		       [](auto &c) { return c.ready(); })) {
+	opt<std::chrono::nanoseconds> timeout;
+	
+	if (deadline) {
+	  timeout.emplace(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			    *deadline - Clock::now()));
+	}
+	
+	wait(s.ready, v, timeout);
+      } else {
+	std::this_thread::yield();
+      }
+      
+      for (auto &c: s.cases) { c.unwatch(s.ready); }
+    }
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef SNACKIS_SELECT_HPP
+#define SNACKIS_SELECT_HPP
+
+#include <chrono>
+#include <vector>
+
+#include "snackis/core/chan.hpp"
+#include "snackis/core/func.hpp"
+#include "snackis/core/futex.hpp"
+#include "snackis/core/opt.hpp"
+
+namespace snackis {
+  // Receives from whichever of several channels is ready first; closed
+  // channels are always ready and pass nullopt to their handler
+  struct Select {
+    struct Case {
+      func<bool ()> recv, ready;
+      func<void (Futex &)> watch, unwatch;
+    };
+
+    std::vector<Case> cases;
+    Futex ready;
+    size_t next;
+
+    Select();
+  };
+
+  // Adds a case calling fn with an opt<T> received from c
+  template <typename T, ChanCard P, ChanCard C, typename FnT>
+  void recv(Select &s, Chan<T, P, C> &c, FnT fn) {
+    s.cases.push_back({
+	[&c, fn]() {
+	  auto closed(c.closed.load());
+	  auto it(try_get(c));
+	  if (!it && !closed) { return false; }
+	  fn(it);
+	  return true;
+	},
+	[&c]() { return get_ready(c); },
+	[&c](Futex &f) { watch(c, f); },
+	[&c](Futex &f) { unwatch(c, f); }});
+  }
+
+  // Runs the handler of one ready case, starting after the one run
+  // previously to keep busy channels from starving the rest; returns false
+  // if deadline passed first
+  bool select(Select &s,
+	      const opt<std::chrono::steady_clock::time_point> &deadline=nullopt);
+}
+
+#endif
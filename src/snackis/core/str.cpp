@@ -36,6 +36,25 @@ namespace snackis {
     while (in_words >> w) { out.insert(w); }
     return out;
   }
+
+  // Splits on ASCII punctuation and whitespace and folds case, bytes above
+  // ASCII are kept to not split UTF-8 sequences
+  std::set<str> term_set(const str &in) {
+    std::set<str> out;
+    str t;
+    
+    for (unsigned char c: in) {
+      if (std::isalnum(c) || c >= 0x80) {
+	t.push_back(std::tolower(c));
+      } else if (!t.empty()) {
+	out.insert(t);
+	t.clear();
+      }
+    }
+
+    if (!t.empty()) { out.insert(t); }
+    return out;
+  }
   
   int64_t to_int64(const str &in) {
     return strtoll(in.c_str(), nullptr, 10);
@@ -28,6 +28,7 @@ namespace snackis {
   }
 
   std::set<str> word_set(const str &in);
+  std::set<str> term_set(const str &in);
 
   size_t find_ci(const str &stack, const str& needle);
   int64_t to_int64(const str &in);
@@ -15,7 +15,7 @@ namespace snackis {
 
   str StrType::read(std::istream &in) const {
     int64_t len(int64_type.read(in));
-    if (!len) { return ""; }
+    if (in.fail() || len <= 0) { return ""; }
     std::vector<char> data(len);
     in.read(&data[0], len);
     return str(data.begin(), data.end());
@@ -0,0 +1,35 @@
+#include "snackis/core/stream.hpp"
+
+namespace snackis {
+  SpanBuf::SpanBuf(const unsigned char *beg, size_t len) { reset(beg, len); }
+
+  void SpanBuf::reset(const unsigned char *beg, size_t len) {
+    auto cbeg(reinterpret_cast<char *>(const_cast<unsigned char *>(beg)));
+    setg(cbeg, cbeg, cbeg+len);
+  }
+
+  const unsigned char *SpanBuf::pos() const {
+    return reinterpret_cast<const unsigned char *>(gptr());
+  }
+  
+  size_t SpanBuf::avail() const { return egptr()-gptr(); }
+
+  void SpanBuf::skip(size_t len) { gbump(len); }
+
+  SpanBuf::pos_type SpanBuf::seekoff(off_type off,
+				     std::ios_base::seekdir dir,
+				     std::ios_base::openmode which) {
+    char *p((dir == std::ios_base::beg)
+	    ? eback()
+	    : ((dir == std::ios_base::end) ? egptr() : gptr()));
+    p += off;
+    if (p < eback() || p > egptr()) { return pos_type(off_type(-1)); }
+    setg(eback(), p, egptr());
+    return pos_type(p-eback());
+  }
+
+  SpanBuf::pos_type SpanBuf::seekpos(pos_type pos,
+				     std::ios_base::openmode which) {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+}
@@ -7,6 +7,20 @@ namespace snackis {
   using Stream = std::stringstream;
   using InStream = std::istringstream;
   using OutStream = std::ostringstream;
+
+  // Reads straight from memory owned by someone else
+  struct SpanBuf: std::streambuf {
+    SpanBuf(const unsigned char *beg=nullptr, size_t len=0);
+    void reset(const unsigned char *beg, size_t len);
+    const unsigned char *pos() const;
+    size_t avail() const;
+    void skip(size_t len);
+  protected:
+    pos_type seekoff(off_type off,
+		     std::ios_base::seekdir dir,
+		     std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+  };
 }
 
 #endif
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cctype>
 #include <vector>
 #include "snackis/core/uid.hpp"
 
@@ -21,6 +23,14 @@ namespace snackis {
     return uuid_compare(x.val, y.val) < 0;
   }
 
+  size_t hash(const UId &id) {
+    uint64_t x, y;
+    std::copy(id.val, id.val+sizeof x, reinterpret_cast<unsigned char *>(&x));
+    std::copy(id.val+sizeof x, id.val+sizeof id.val,
+	      reinterpret_cast<unsigned char *>(&y));
+    return x ^ y;
+  }
+
   str to_str(const UId &in) {
     char cs[37];
     uuid_unparse_lower(in.val, cs);
@@ -37,4 +47,35 @@ namespace snackis {
     if (uuid_parse(in.c_str(), out.val) != 0) { return nullopt; }
     return out;
   }
+
+  // Returns the first and last ids starting with hex prefix in, ids order
+  // as their hex representation
+  opt<std::pair<UId, UId>> parse_uid_prefix(const str &in) {
+    UId min, max;
+    std::fill(max.val, max.val+sizeof max.val, 0xff);
+    size_t n(0);
+    
+    for (char c: in) {
+      if (c == '-') { continue; }
+      const char lc(std::tolower(c));
+      int v(-1);
+      if (lc >= '0' && lc <= '9') { v = lc-'0'; }
+      if (lc >= 'a' && lc <= 'f') { v = lc-'a'+10; }
+      if (v == -1 || n == sizeof min.val*2) { return nullopt; }
+      auto &lo(min.val[n/2]), &hi(max.val[n/2]);
+
+      if (n % 2) {
+	lo |= v;
+	hi = (hi & 0xf0) | v;
+      } else {
+	lo = v << 4;
+	hi = (v << 4) | 0x0f;
+      }
+
+      n++;
+    }
+
+    if (!n) { return nullopt; }
+    return std::make_pair(min, max);
+  }
 }
@@ -1,6 +1,7 @@
 #ifndef SNACKIS_UID_HPP
 #define SNACKIS_UID_HPP
 
+#include <utility>
 #include <uuid/uuid.h>
 #include "snackis/core/fmt.hpp"
 #include "snackis/core/str.hpp"
@@ -17,11 +18,13 @@ namespace snackis {
   bool operator==(const UId &x, const UId &y);
   bool operator!=(const UId &x, const UId &y);
   bool operator<(const UId &x, const UId &y);
+  size_t hash(const UId &id);
 
   str to_str(const UId &in);
   template <>
   str fmt_arg(const UId &arg);
   opt<UId> parse_uid(const str &in);
+  opt<std::pair<UId, UId>> parse_uid_prefix(const str &in);
 }
 
 #endif
@@ -40,12 +40,17 @@ namespace crypt {
     return out;
   }
 
-  Data decrypt(const Secret &secret, const unsigned char *in, size_t len) {
-    Data out;
+  bool decrypt(const Secret &secret, const unsigned char *in, size_t len,
+	       Data &out) {
+    if (len < Secret::NONCE_SIZE+crypto_aead_chacha20poly1305_IETF_ABYTES) {
+      ERROR(Crypt, "Failed decrypting secret message");
+      return false;
+    }
+    
     out.resize(len-Secret::NONCE_SIZE-crypto_aead_chacha20poly1305_IETF_ABYTES);
 
     unsigned long long dlen;
-    if (crypto_aead_chacha20poly1305_ietf_decrypt(&out[0],
+    if (crypto_aead_chacha20poly1305_ietf_decrypt(out.data(),
 						  &dlen,
 						  nullptr,
 						  in+Secret::NONCE_SIZE,
@@ -53,10 +58,16 @@ namespace crypt {
 						  nullptr, 0,
 						  in, hash(secret)) != 0) {
       ERROR(Crypt, "Failed decrypting secret message");
-      return out;
+      return false;
     }
 
     out.resize(dlen);
+    return true;
+  }
+
+  Data decrypt(const Secret &secret, const unsigned char *in, size_t len) {
+    Data out;
+    decrypt(secret, in, len, out);
     return out;
   }
 }}
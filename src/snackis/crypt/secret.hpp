@@ -26,6 +26,8 @@ namespace crypt {
 
   Data encrypt(const Secret &secret, const unsigned char *in, size_t len);
   Data decrypt(const Secret &secret, const unsigned char *in, size_t len);
+  bool decrypt(const Secret &secret, const unsigned char *in, size_t len,
+	       Data &out);
 }}
   
 #endif
@@ -1,5 +1,6 @@
 #include <chrono>
 #include "snackis/ctx.hpp"
+#include "snackis/snackis.hpp"
 #include "snackis/db/error.hpp"
 #include "snackis/net/imap.hpp"
 #include "snackis/net/smtp.hpp"
@@ -11,6 +12,8 @@ namespace snackis {
 
   void open(Ctx &ctx) {
     TRACE("Opening Snackis context");
+    // Revision was rejected by init_db_rev, leave files alone
+    if (ctx.proc.rev == -1) { return; }
     db::Trans trans(ctx);
     TRY(try_open);
     
@@ -18,6 +21,24 @@ namespace snackis {
     create_path(*get_val(ctx.settings.save_folder));
     slurp(ctx);
 
+    if (ctx.proc.rev < DB_REV) {
+      // Sort tables were replaced by in-memory indexes in revision 6
+      for (auto n: {"peers_sort", "scripts_sort", "feeds_sort", "posts_sort",
+	    "feed_posts", "inbox_sort", "projects_sort", "tasks_sort"}) {
+	remove_path(db::get_path(ctx, fmt("%0.tbl", n)));
+	remove_path(db::get_path(ctx, fmt("%0.snap", n)));
+      }
+      
+      upgrade(ctx.settings);
+      db::upgrade(ctx);
+    }
+
+    const int64_t durability(*get_val(ctx.settings.durability));
+    ctx.proc.durability =
+      (durability < db::DURABLE_NONE || durability > db::DURABLE_COMMIT)
+      ? db::DURABLE_FLUSH
+      : db::Durability(durability);
+
     opt<UId> me_id = get_val(ctx.settings.whoami);
     if (!me_id) {
       Peer me(ctx);
@@ -11,14 +11,39 @@
 
 namespace snackis {  
   static void init_indexes(Db &db) {
+    db.peers.indexes.insert(&db.peers_ids);
     db.peers.indexes.insert(&db.peers_sort);
+    db.peers.indexes.insert(&db.peers_text);
+    db.peers.indexes.insert(&db.peers_tags);
+    db.scripts.indexes.insert(&db.scripts_ids);
     db.scripts.indexes.insert(&db.scripts_sort);
+    db.scripts.indexes.insert(&db.scripts_tags);
+    db.feeds.indexes.insert(&db.feeds_ids);
     db.feeds.indexes.insert(&db.feeds_sort);
+    db.feeds.indexes.insert(&db.feeds_tags);
+    db.posts.indexes.insert(&db.posts_ids);
     db.posts.indexes.insert(&db.posts_sort);
     db.posts.indexes.insert(&db.feed_posts);
+    db.posts.indexes.insert(&db.posts_text);
+    db.posts.indexes.insert(&db.posts_tags);
     db.inbox.indexes.insert(&db.inbox_sort);
+    db.projects.indexes.insert(&db.projects_ids);
     db.projects.indexes.insert(&db.projects_sort);
+    db.projects.indexes.insert(&db.projects_tags);
+    db.tasks.indexes.insert(&db.tasks_ids);
     db.tasks.indexes.insert(&db.tasks_sort);
+    db.tasks.indexes.insert(&db.tasks_text);
+    db.tasks.indexes.insert(&db.tasks_tags);
+  }
+
+  void drop_gui_indexes(Db &db) {
+    db.peers.indexes.clear();
+    db.scripts.indexes.clear();
+    db.feeds.indexes.clear();
+    db.posts.indexes.clear();
+    db.inbox.indexes.clear();
+    db.projects.indexes.clear();
+    db.tasks.indexes.clear();
   }
 
   static void init_events(Db &db, Ctx &ctx) {
@@ -148,32 +173,47 @@ namespace snackis {
 	  {&peer_created_at, &peer_changed_at, &peer_name, &peer_email, &peer_info,
 	      &peer_tags, &peer_crypt_key, &peer_active}),
 
-    peers_sort(ctx, "peers_sort", db::make_key(peer_name, peer_id), {}),
+    peers_ids(db::make_key(peer_id)),
+
+    peers_sort(db::make_key(peer_name, peer_id)),
+
+    peers_text({&peer_name, &peer_email, &peer_info}),
+
+    peers_tags(peer_tags),
     
     scripts(ctx, "scripts", script_key, script_cols),
 
-    scripts_sort(ctx, "scripts_sort",
-		 db::make_key(script_name, script_created_at, script_id),
-		 {}),
+    scripts_ids(db::make_key(script_id)),
+
+    scripts_sort(db::make_key(script_name, script_created_at, script_id)),
+
+    scripts_tags(script_tags),
 
     scripts_share({&script_id, &script_created_at, &script_changed_at, &script_name,
 	  &script_code, &script_peer_ids}),
 
     feeds(ctx, "feeds", feed_key, feed_cols),
 
-    feeds_sort(ctx, "feeds_sort", db::make_key(feed_created_at, feed_id), {}),
+    feeds_ids(db::make_key(feed_id)),
+
+    feeds_sort(db::make_key(feed_created_at, feed_id)),
+
+    feeds_tags(feed_tags),
 
     feeds_share({&feed_id, &feed_created_at, &feed_changed_at, &feed_name,
 	  &feed_info, &feed_active, &feed_visible, &feed_peer_ids}),
     
     posts(ctx, "posts", post_key, post_cols),
 
-    posts_sort(ctx, "posts_sort", db::make_key(post_created_at, post_id), {}),
+    posts_ids(db::make_key(post_id)),
 
-    feed_posts(ctx,
-	       "feed_posts",
-	       db::make_key(post_feed_id, post_created_at, post_id),
-	       {}),
+    posts_sort(db::make_key(post_created_at, post_id)),
+
+    feed_posts(db::make_key(post_feed_id, post_created_at, post_id)),
+
+    posts_text({&post_body}),
+
+    posts_tags(post_tags),
 
     posts_share({&post_id, &post_feed_id, &post_created_at, &post_changed_at,
 	  &post_body, &post_peer_ids}),
@@ -188,19 +228,28 @@ namespace snackis {
 	       &msg_crypt_key, &msg_script, &msg_feed, &msg_post, &msg_project,
 	       &msg_task}),
 
-    inbox_sort(ctx, "inbox_sort", db::make_key(msg_fetched_at, msg_id), {}),
+    inbox_sort(db::make_key(msg_fetched_at, msg_id)),
 
     projects(ctx, "projects", project_key, project_cols),
 
-    projects_sort(ctx, "projects_sort", db::make_key(project_name, project_id), {}),
+    projects_ids(db::make_key(project_id)),
+
+    projects_sort(db::make_key(project_name, project_id)),
+
+    projects_tags(project_tags),
 
     projects_share({&project_id, &project_created_at, &project_changed_at,
 	  &project_name, &project_info, &project_active, &project_peer_ids}),
     
     tasks(ctx, "tasks", task_key, task_cols),
 
-    tasks_sort(ctx, "tasks_sort", db::make_key(task_prio, task_created_at, task_id),
-	       {}),
+    tasks_ids(db::make_key(task_id)),
+
+    tasks_sort(db::make_key(task_prio, task_created_at, task_id)),
+
+    tasks_text({&task_name, &task_info}),
+
+    tasks_tags(task_tags),
 
     tasks_share({&task_id, &task_created_at, &task_changed_at, &task_project_id,
 	  &task_name, &task_info, &task_done, &task_done_at, &task_peer_ids})
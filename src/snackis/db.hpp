@@ -14,7 +14,11 @@
 #include "snackis/crypt/pub_key.hpp"
 #include "snackis/db/col.hpp"
 #include "snackis/db/ctx.hpp"
+#include "snackis/db/id_index.hpp"
+#include "snackis/db/index.hpp"
 #include "snackis/db/table.hpp"
+#include "snackis/db/tag_index.hpp"
+#include "snackis/db/text_index.hpp"
 
 namespace snackis {
   struct Db {
@@ -23,34 +27,52 @@ namespace snackis {
     db::Table<Invite, str> invites;
 	    
     db::Table<Peer, UId> peers;
-    db::Table<Peer, str, UId> peers_sort;
+    db::IdIndex<Peer> peers_ids;
+    db::KeyIndex<Peer, str, UId> peers_sort;
+    db::TextIndex<Peer> peers_text;
+    db::TagIndex<Peer> peers_tags;
 
     db::Table<Script, UId> scripts;
-    db::Table<Script, str, Time, UId> scripts_sort;
+    db::IdIndex<Script> scripts_ids;
+    db::KeyIndex<Script, str, Time, UId> scripts_sort;
+    db::TagIndex<Script> scripts_tags;
     db::Schema<Script> scripts_share;
 
     db::Table<Feed, UId> feeds;
-    db::Table<Feed, Time, UId> feeds_sort;
+    db::IdIndex<Feed> feeds_ids;
+    db::KeyIndex<Feed, Time, UId> feeds_sort;
+    db::TagIndex<Feed> feeds_tags;
     db::Schema<Feed> feeds_share;
 
     db::Table<Post, UId> posts;
-    db::Table<Post, Time, UId> posts_sort;
-    db::Table<Post, UId, Time, UId> feed_posts;
+    db::IdIndex<Post> posts_ids;
+    db::KeyIndex<Post, Time, UId> posts_sort;
+    db::KeyIndex<Post, UId, Time, UId> feed_posts;
+    db::TextIndex<Post> posts_text;
+    db::TagIndex<Post> posts_tags;
     db::Schema<Post> posts_share;
     
     db::Table<Msg, UId> inbox, outbox;
-    db::Table<Msg, Time, UId> inbox_sort;
+    db::KeyIndex<Msg, Time, UId> inbox_sort;
 
     db::Table<Project, UId> projects;
-    db::Table<Project, str, UId> projects_sort;
+    db::IdIndex<Project> projects_ids;
+    db::KeyIndex<Project, str, UId> projects_sort;
+    db::TagIndex<Project> projects_tags;
     db::Schema<Project> projects_share;
 
     db::Table<Task, UId> tasks;
-    db::Table<Task, int64_t, Time, UId> tasks_sort;
+    db::IdIndex<Task> tasks_ids;
+    db::KeyIndex<Task, int64_t, Time, UId> tasks_sort;
+    db::TextIndex<Task> tasks_text;
+    db::TagIndex<Task> tasks_tags;
     db::Schema<Task> tasks_share;
 
     Db(Ctx &ctx);
   };
+
+  // Sort, id, text and tag indexes only serve the GUI
+  void drop_gui_indexes(Db &db);
 }
 
 #endif
@@ -2,7 +2,9 @@
 #define SNACKIS_DB_BASIC_COL_HPP
 
 #include <iostream>
+#include <vector>
 
+#include "snackis/core/error.hpp"
 #include "snackis/core/str.hpp"
 #include "snackis/db/rec.hpp"
 
@@ -11,7 +13,10 @@ namespace db {
   template <typename RecT>
   struct BasicCol {
     const str name;
+    const size_t ord;
+    
     BasicCol(const str &name);
+    virtual ~BasicCol();
     virtual void copy(RecT &dest, const RecT &src) const=0;
     virtual void copy(Rec<RecT> &dest, const RecT &src) const=0;
     virtual void copy(RecT &dest, const Rec<RecT> &src) const=0;
@@ -22,7 +27,20 @@ namespace db {
   };
 
   template <typename RecT>
-  BasicCol<RecT>::BasicCol(const str &name): name(name) { }
+  std::vector<const BasicCol<RecT> *> &rec_cols() {
+    static std::vector<const BasicCol<RecT> *> cols;
+    return cols;
+  }
+  
+  template <typename RecT>
+  BasicCol<RecT>::BasicCol(const str &name):
+    name(name), ord(rec_cols<RecT>().size()) {
+    CHECK(ord, _ < MAX_COLS);
+    rec_cols<RecT>().push_back(this);
+  }
+
+  template <typename RecT>
+  BasicCol<RecT>::~BasicCol() { rec_cols<RecT>()[ord] = nullptr; }
 }}
 
 #endif
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <fstream>
 #include "snackis/core/fmt.hpp"
+#include "snackis/core/int64_type.hpp"
 #include "snackis/db/ctx.hpp"
 #include "snackis/db/error.hpp"
 #include "snackis/db/basic_table.hpp"
@@ -8,5 +11,59 @@ namespace db {
   BasicTable::BasicTable(Ctx &ctx, const str &name):
     ctx(ctx),
     name(name),
-    path(get_path(ctx, fmt("%0.tbl", name))) { }
+    path(get_path(ctx, fmt("%0.tbl", name))),
+    snap_path(get_path(ctx, fmt("%0.snap", name))),
+    dead_bytes(0)
+  { }
+
+  SlurpRes::SlurpRes():
+    size(0), dead(0), truncated(false)
+  { }
+
+  int64_t dead_bytes(TableOp op, int64_t size) {
+    switch (op) {
+    case TABLE_UPDATE:
+      return size;
+    case TABLE_ERASE:
+      return size*2;
+    default:
+      break;
+    }
+
+    return 0;
+  }
+
+  void write_page(const crypt::Secret &sec, const str &data, std::ostream &out) {
+    const uint8_t op(TABLE_PAGE);
+    out.write(reinterpret_cast<const char *>(&op), sizeof op);
+    const Data edata(encrypt(sec, (const unsigned char *)data.data(), data.size()));
+    int64_type.write(edata.size(), out);
+    out.write((const char *)&edata[0], edata.size());
+  }
+
+  void write_snapshot_header(int64_t size, int64_t dead, std::ostream &out) {
+    out.write(reinterpret_cast<const char *>(&size), sizeof size);
+    out.write(reinterpret_cast<const char *>(&dead), sizeof dead);
+  }
+
+  bool read_snapshot_header(const unsigned char *data, size_t len,
+			    int64_t &size, int64_t &dead) {
+    if (len < SNAPSHOT_HEADER) { return false; }
+    std::copy(data, data+sizeof size, reinterpret_cast<unsigned char *>(&size));
+    std::copy(data+sizeof size, data+SNAPSHOT_HEADER,
+	      reinterpret_cast<unsigned char *>(&dead));
+    return size >= 0 && dead >= 0;
+  }
+
+  int64_t read_snapshot_size(const BasicTable &tbl) {
+    std::ifstream in(tbl.snap_path.string(), std::ios::in | std::ios::binary);
+    unsigned char buf[SNAPSHOT_HEADER];
+    in.read(reinterpret_cast<char *>(buf), SNAPSHOT_HEADER);
+    int64_t size(-1), dead(0);
+    if (in.fail() || !read_snapshot_header(buf, SNAPSHOT_HEADER, size, dead)) {
+      return -1;
+    }
+    
+    return (size <= path_size(tbl.path)) ? size : -1;
+  }
 }}
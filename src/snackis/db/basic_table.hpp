@@ -1,22 +1,48 @@
 #ifndef SNACKIS_DB_BASIC_TABLE_HPP
 #define SNACKIS_DB_BASIC_TABLE_HPP
 
+#include <cstdint>
 #include "snackis/core/path.hpp"
 #include "snackis/core/str.hpp"
+#include "snackis/crypt/secret.hpp"
 
 namespace snackis {  
 namespace db {
   struct Ctx;
+
+  // Pages hold records that were encrypted together
+  enum TableOp {TABLE_INSERT, TABLE_UPDATE, TABLE_ERASE, TABLE_SCHEMA, TABLE_PAGE};
   
   struct BasicTable {
     Ctx &ctx;
     const str name;
-    const Path path;
+    const Path path, snap_path;
+    int64_t dead_bytes;
     
     BasicTable(Ctx &ctx, const str &name);
+    virtual void write_schema(std::ostream &out) = 0;
     virtual void dump(std::ostream &out) = 0;
     virtual void slurp() = 0;
+    virtual int64_t compact(int64_t size, std::ostream &out) = 0;
+  };
+
+  struct SlurpRes {
+    int64_t size, dead;
+    bool truncated;
+
+    SlurpRes();
   };
+  
+  // Snapshots start with the log size they cover and its dead bytes
+  const size_t SNAPSHOT_HEADER(2*sizeof(int64_t));
+
+  // Estimates bytes made obsolete by writing a record of size for op
+  int64_t dead_bytes(TableOp op, int64_t size);
+  void write_page(const crypt::Secret &sec, const str &data, std::ostream &out);
+  void write_snapshot_header(int64_t size, int64_t dead, std::ostream &out);
+  bool read_snapshot_header(const unsigned char *data, size_t len,
+			    int64_t &size, int64_t &dead);
+  int64_t read_snapshot_size(const BasicTable &tbl);
 }}
 
 #endif
@@ -1,20 +1,47 @@
 #include "snackis/core/error.hpp"
+#include "snackis/core/utils.hpp"
 #include "snackis/db/change.hpp"
 #include "snackis/db/trans.hpp"
 
 namespace snackis {
 namespace db {
-  ChangeSet::ChangeSet(Ctx &ctx, const str &lbl, Changes &chs):
-    ctx(ctx), label(lbl), committed_at(now())
-  {
-    changes.swap(chs);
+  Change::~Change() { }
+
+  const size_t ChangeLog::MIN_CHUNK(1024), ChangeLog::MAX_CHUNK(64*1024);
+  
+  ChangeLog::ChangeLog():
+    chunk_size(0), chunk_offs(0)
+  { }
+
+  ChangeLog::~ChangeLog() {
+    for (auto c(changes.rbegin()); c != changes.rend(); c++) { (*c)->~Change(); }
+  }
+  
+  ChangeSet::ChangeSet(Ctx &ctx, const str &lbl,
+		       const std::shared_ptr<ChangeLog> &chs):
+    ctx(ctx), label(lbl), committed_at(now()), changes(chs)
+  { }
+
+  void *alloc(ChangeLog &log, size_t size, size_t align) {
+    size_t offs((log.chunk_offs + align - 1) & ~(align - 1));
+
+    // Chunks double in size to keep small transactions cheap
+    if (log.chunks.empty() || offs + size > log.chunk_size) {
+      log.chunk_size = max(size, min(max(log.chunk_size*2, ChangeLog::MIN_CHUNK),
+				     ChangeLog::MAX_CHUNK));
+      log.chunks.emplace_back(new unsigned char[log.chunk_size]);
+      offs = 0;
+    }
+
+    log.chunk_offs = offs + size;
+    return log.chunks.back().get() + offs;
   }
   
   void undo(ChangeSet &cs) {
     db::Trans trans(cs.ctx);
     TRY(try_undo);
     
-    for (auto c: cs.changes) { c->undo(); }
+    for (auto c: cs.changes->changes) { c->undo(); }
 
     if (try_undo.errors.empty()) {
       db::commit(trans, nullopt);
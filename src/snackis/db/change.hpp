@@ -2,32 +2,61 @@
 #define SNACKIS_DB_CHANGE_HPP
 
 #include <memory>
+#include <vector>
+#include "snackis/core/opt.hpp"
 #include "snackis/core/str.hpp"
 #include "snackis/core/time.hpp"
+#include "snackis/crypt/secret.hpp"
 
 namespace snackis {
 namespace db {
+  struct BasicTable;
   struct Ctx;
   
   struct Change {
-    virtual Path table_path() const = 0;
-    virtual void write(std::ostream &out) const = 0;
+    virtual ~Change();
+    virtual BasicTable &base_table() const = 0;
+    virtual int64_t dead_bytes(int64_t size) const = 0;
+    virtual void write_schema(std::ostream &out) const = 0;
+    virtual void write(std::ostream &out, const opt<crypt::Secret> &sec) const = 0;
     virtual void apply(Ctx &ctx) const = 0;
     virtual void rollback() const = 0;
     virtual void undo() const = 0;
   };
 
-  using Changes = std::vector<std::shared_ptr<Change>>;
+  // Changes logged by a transaction are allocated from chunks owned by the
+  // log, which is shared as is by the write loop, change loop and undo stack
+  struct ChangeLog {
+    static const size_t MIN_CHUNK, MAX_CHUNK;
+    std::vector<std::unique_ptr<unsigned char[]>> chunks;
+    size_t chunk_size, chunk_offs;
+    std::vector<Change *> changes;
+
+    ChangeLog();
+    ChangeLog(const ChangeLog &) = delete;
+    ~ChangeLog();
+    ChangeLog &operator =(const ChangeLog &) = delete;
+  };
+
+  using Changes = std::vector<std::shared_ptr<const ChangeLog>>;
 
   struct ChangeSet {
     Ctx &ctx;
     str label;
     Time committed_at;
-    Changes changes;
+    std::shared_ptr<const ChangeLog> changes;
 
-    ChangeSet(Ctx &ctx, const str &lbl, Changes &chs);
+    ChangeSet(Ctx &ctx, const str &lbl, const std::shared_ptr<ChangeLog> &chs);
   };
 
+  void *alloc(ChangeLog &log, size_t size, size_t align);
+
+  template <typename ChangeT, typename...Args>
+  void log_change(ChangeLog &log, Args &&...args) {
+    void *p(alloc(log, sizeof(ChangeT), alignof(ChangeT)));
+    log.changes.push_back(new (p) ChangeT(std::forward<Args>(args)...));
+  }
+
   void undo(ChangeSet &cs);
 }}
 
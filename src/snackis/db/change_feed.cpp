@@ -0,0 +1,59 @@
+#include "snackis/core/utils.hpp"
+#include "snackis/db/change_feed.hpp"
+
+namespace snackis {
+namespace db {
+  ChangeFeed::ChangeFeed():
+    next_seq(0)
+  { }
+
+  static void reclaim(ChangeFeed &feed) {
+    int64_t min_seq(feed.next_seq);
+    for (auto &c: feed.cursors) { min_seq = min(min_seq, c.second); }
+
+    while (!feed.entries.empty() && feed.entries.front().seq < min_seq) {
+      feed.entries.pop_front();
+    }
+  }
+  
+  void connect(ChangeFeed &feed, const Ctx &ctx) {
+    std::unique_lock<std::mutex> lock(feed.mutex);
+    feed.cursors[&ctx] = feed.next_seq;
+  }
+
+  void disconnect(ChangeFeed &feed, const Ctx &ctx) {
+    std::unique_lock<std::mutex> lock(feed.mutex);
+    feed.cursors.erase(&ctx);
+    reclaim(feed);
+  }
+
+  void push(ChangeFeed &feed,
+	    const Ctx &sender,
+	    const std::shared_ptr<const ChangeLog> &changes) {
+    std::unique_lock<std::mutex> lock(feed.mutex);
+    const int64_t seq(feed.next_seq++);
+    feed.entries.push_back({seq, &sender, changes});
+    
+    // Senders that are caught up skip their own changes
+    auto fnd(feed.cursors.find(&sender));
+    if (fnd != feed.cursors.end() && fnd->second == seq) { fnd->second++; }
+    reclaim(feed);
+  }
+
+  Changes read(ChangeFeed &feed, const Ctx &ctx) {
+    std::unique_lock<std::mutex> lock(feed.mutex);
+    Changes out;
+    auto &cur(feed.cursors.at(&ctx));
+    if (cur == feed.next_seq) { return out; }
+    
+    for (auto e(feed.entries.begin() + (cur - feed.entries.front().seq));
+	 e != feed.entries.end();
+	 e++) {
+      if (e->sender != &ctx) { out.push_back(e->changes); }
+    }
+
+    cur = feed.next_seq;
+    reclaim(feed);
+    return out;
+  }
+}}
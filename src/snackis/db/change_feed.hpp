@@ -0,0 +1,38 @@
+#ifndef SNACKIS_DB_CHANGE_FEED_HPP
+#define SNACKIS_DB_CHANGE_FEED_HPP
+
+#include <deque>
+#include <map>
+#include <mutex>
+
+#include "snackis/db/change.hpp"
+
+namespace snackis {
+namespace db {
+  // Committed change logs in commit order, contexts read from their cursor
+  // onward and entries are dropped once every cursor has passed them
+  struct ChangeFeed {
+    struct Entry {
+      int64_t seq;
+      const Ctx *sender;
+      std::shared_ptr<const ChangeLog> changes;
+    };
+
+    std::mutex mutex;
+    std::deque<Entry> entries;
+    int64_t next_seq;
+    std::map<const Ctx *, int64_t> cursors;
+    
+    ChangeFeed();
+  };
+
+  void connect(ChangeFeed &feed, const Ctx &ctx);
+  void disconnect(ChangeFeed &feed, const Ctx &ctx);
+  void push(ChangeFeed &feed,
+	    const Ctx &sender,
+	    const std::shared_ptr<const ChangeLog> &changes);
+  // Returns changes committed by other contexts since the previous call
+  Changes read(ChangeFeed &feed, const Ctx &ctx);
+}}
+
+#endif
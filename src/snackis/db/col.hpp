@@ -25,6 +25,13 @@ namespace db {
     void write(const Val &val, std::ostream &out) const override;
   };
 
+  // Null values are not stored in records
+  template <typename RecT, typename ValT>
+  ValT get_val(const Rec<RecT> &rec, const Col<RecT, ValT> &col) {
+    auto fnd(find(rec, col));
+    return fnd ? col.type.from_val(*fnd) : col.type.null;
+  }
+
   template <typename RecT, typename ValT>
   Col<RecT, ValT>::Col(const str &name, Type<ValT> &type, ValT RecT::* fld):
     BasicCol<RecT>(name), type(type), field(fld)
@@ -38,13 +45,13 @@ namespace db {
   template <typename RecT, typename ValT>
   void Col<RecT, ValT>::copy(Rec<RecT> &dest, const RecT &src) const {
     auto &val(src.*field);
-    if (!type.is_null(val)) { dest[this] = type.to_val(val); }
+    if (!type.is_null(val)) { db::set(dest, *this, type.to_val(val)); }
   }
 
   template <typename RecT, typename ValT>
   void Col<RecT, ValT>::copy(RecT &dest, const Rec<RecT> &src) const {
-    auto fnd(src.find(this));
-    if (fnd != src.end()) { set(dest, fnd->second); }
+    auto fnd(find(src, *this));
+    if (fnd) { set(dest, *fnd); }
   }
 
   template <typename RecT, typename ValT>
@@ -1,7 +1,13 @@
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include "snackis/ctx.hpp"
+#include "snackis/core/parallel.hpp"
+#include "snackis/core/time.hpp"
 #include "snackis/snackis.hpp"
 #include "snackis/crypt/error.hpp"
+#include "snackis/db/basic_table.hpp"
+#include "snackis/db/error.hpp"
 #include "snackis/db/proc.hpp"
 
 namespace snackis {
@@ -9,20 +15,11 @@ namespace db {
   Ctx::Ctx(Proc &p, size_t max_buf):
     proc(p), inbox(max_buf), trans(nullptr)
   { 
-    Msg msg(MSG_CONNECT);
-    set(msg, Msg::SENDER, this);
-    put(proc.inbox, msg);
-    
-    auto res(get(inbox));
-    CHECK(res, _);
-    CHECK(res->type == MSG_OK, _);
+    connect(proc.feed, *this);
   }
 
   Ctx::~Ctx() { 
-    Msg msg(MSG_DISCONNECT);
-    set(msg, Msg::SENDER, this);
-    put(proc.inbox, msg);
-    get(inbox);
+    disconnect(proc.feed, *this);
   }
 
   Path get_path(const Ctx &ctx, const str &fname) {
@@ -82,33 +79,108 @@ namespace db {
 
   void slurp(Ctx &ctx) {
     TRY(try_slurp);
+    std::vector<std::pair<BasicTable *, int64_t>> tbls;
+    
     for (auto t: ctx.tables) {
-      if (path_exists(t.second->path)) { t.second->slurp(); }
+      auto size(path_size(t.second->path));
+      if (size != -1) { tbls.emplace_back(t.second, size); }
     }
+
+    // Largest tables first to keep the tail short
+    std::stable_sort(tbls.begin(), tbls.end(),
+		     [](auto &x, auto &y) { return x.second > y.second; });
+    std::vector<int64_t> times(tbls.size(), 0);
+    auto start(Clock::now());
+    
+    parallel_for(tbls.size(), [&](size_t i) {
+	auto tstart(Clock::now());
+	tbls[i].first->slurp();
+	times[i] = std::chrono::duration_cast<std::chrono::milliseconds>(
+	  Clock::now() - tstart).count();
+      });
+
+    for (size_t i(0); i < tbls.size(); i++) {
+      log(ctx, "Loaded %0 (%1 bytes) in %2ms",
+	  tbls[i].first->name, tbls[i].second, times[i]);
+    }
+    
+    log(ctx, "Loaded %0 tables in %1ms", tbls.size(),
+	std::chrono::duration_cast<std::chrono::milliseconds>(
+	  Clock::now() - start).count());
   }
 
+  // Runs before anything is written through the write loop, the
+  // revision is only bumped once every table has been written and synced
+  void upgrade(Ctx &ctx) {
+    TRY(try_upgrade);
+    std::vector<BasicTable *> tbls;
+    
+    for (auto &t: ctx.tables) {
+      auto &tbl(*t.second);
+      if (!path_exists(tbl.path)) { continue; }
+      tbls.push_back(&tbl);
+      const Path p(upgrade_path(tbl.path));
+      std::ofstream out(p.string(),
+			std::ios::out | std::ios::binary | std::ios::trunc);
+      tbl.dump(out);
+      out.close();
+
+      if (out.fail() || !sync_path(p)) {
+	ERROR(Db, fmt("Failed upgrading %0", tbl.name));
+	break;
+      }
+    }
+
+    if (try_upgrade.errors.empty()) {
+      // Snapshot offsets refer to the old logs
+      for (auto t: tbls) { remove_path(t->snap_path); }
+      upgrade_rev(ctx.proc);
+    }
+
+    if (!try_upgrade.errors.empty()) {
+      for (auto t: tbls) { remove_path(upgrade_path(t->path)); }
+      return;
+    }
+    
+    for (auto t: tbls) {
+      rename_path(upgrade_path(t->path), t->path);
+      t->dead_bytes = 0;
+    }
+  }
+  
   int64_t rewrite(Ctx &ctx) {
     TRY(try_rewrite);
     Msg msg(MSG_REWRITE);
     set(msg, Msg::SENDER, &ctx);
-    put(ctx.proc.inbox, msg);
+    put(ctx.proc.inbox, std::move(msg));
     auto res(get(ctx.inbox));
     return (res && res->type == MSG_OK) ? get(*res, Msg::RECLAIMED) : -1;
   }
 
-  int64_t refresh(Ctx &ctx) {
-    TRY(try_refresh);
-    Msg msg(MSG_REFRESH);
+  bool sync(Ctx &ctx) {
+    Msg msg(MSG_SYNC);
     set(msg, Msg::SENDER, &ctx);
-    put(ctx.proc.inbox, msg);
+    put(ctx.proc.inbox, std::move(msg));
     auto res(get(ctx.inbox));
+    return res && res->type == MSG_OK;
+  }
+
+  // Returns once the write loop is done with everything committed so far
+  void wait_writes(Ctx &ctx) {
+    Msg msg(MSG_WAIT);
+    set(msg, Msg::SENDER, &ctx);
+    put(ctx.proc.write_loop.inbox, std::move(msg));
+    get(ctx.inbox);
+  }
+
+  int64_t refresh(Ctx &ctx) {
+    int64_t cnt(0);
     
-    if (res && res->type == MSG_OK) {
-      auto cs(get(*res, Msg::CHANGES));
-      for (auto &c: cs) { c->apply(ctx); }
-      return cs.size();
+    for (auto &l: read(ctx.proc.feed, ctx)) {
+      for (auto c: l->changes) { c->apply(ctx); }
+      cnt += l->changes.size();
     }
-
-    return -1;
+    
+    return cnt;
   }
 }}
@@ -25,7 +25,8 @@ namespace db {
   
   struct Ctx {
     Proc &proc;
-    Chan<Msg> inbox;
+    // Replies, which only come from the write loop
+    Chan<Msg, CHAN_SINGLE, CHAN_SINGLE> inbox;
     opt<crypt::Secret> secret;
     std::map<str, BasicTable *> tables;
     Trans *trans;
@@ -42,8 +43,11 @@ namespace db {
   bool login(Ctx &ctx, const str &pass);
   void open(Ctx &ctx);
   void slurp(Ctx &ctx);
+  void upgrade(Ctx &ctx);
   int64_t rewrite(Ctx &ctx);
   int64_t refresh(Ctx &ctx);
+  bool sync(Ctx &ctx);
+  void wait_writes(Ctx &ctx);
 
   template <typename...Args>
   void log(const Ctx &ctx, const str &spec, const Args&...args) {
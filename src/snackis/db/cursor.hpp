@@ -0,0 +1,130 @@
+#ifndef SNACKIS_DB_CURSOR_HPP
+#define SNACKIS_DB_CURSOR_HPP
+
+#include <tuple>
+
+#include "snackis/core/btree.hpp"
+#include "snackis/core/opt.hpp"
+#include "snackis/db/index.hpp"
+#include "snackis/db/rec.hpp"
+
+namespace snackis {
+namespace db {
+  enum ScanDir {SCAN_FWD, SCAN_REV};
+
+  // Walks sorted records in either direction; ranges are half open, seek
+  // positions forward cursors at the first key not before the given key
+  // and reverse cursors at the last key before it
+  template <typename K, typename V>
+  struct Cursor {
+    using Recs = BTree<K, V>;
+    using Iter = typename Recs::const_iterator;
+    using Item = typename Recs::value_type;
+
+    const Recs &recs;
+    const ScanDir dir;
+    opt<K> from, to;
+    size_t prefix, limit, count;
+    Iter it;
+    bool done;
+
+    Cursor(const Recs &recs, ScanDir dir);
+  };
+
+  template <size_t I=0, typename...T>
+  bool prefix_eq(const std::tuple<T...> &x, const std::tuple<T...> &y,
+		 size_t len) {
+    if constexpr (I == sizeof...(T)) {
+      return true;
+    } else {
+      if (I >= len) { return true; }
+      auto &xv(std::get<I>(x));
+      auto &yv(std::get<I>(y));
+      return !(xv < yv) && !(yv < xv) && prefix_eq<I+1>(x, y, len);
+    }
+  }
+
+  template <typename K, typename V>
+  void seek(Cursor<K, V> &cur, const K &key, size_t prefix=0) {
+    cur.from.emplace(key);
+    cur.prefix = prefix;
+    cur.it = cur.recs.lower_bound(key);
+    cur.done = false;
+
+    if (cur.dir == SCAN_REV) {
+      if (cur.it == cur.recs.begin()) {
+	cur.done = true;
+      } else {
+	cur.it--;
+      }
+    }
+  }
+
+  // Stops forward cursors before keys not before key, and reverse cursors
+  // before keys before key
+  template <typename K, typename V>
+  void bound(Cursor<K, V> &cur, const K &key) {
+    cur.to.emplace(key);
+  }
+
+  template <typename K, typename V>
+  Cursor<K, V>::Cursor(const Recs &recs, ScanDir dir):
+    recs(recs), dir(dir), prefix(0), limit(0), count(0),
+    it(dir == SCAN_FWD || recs.empty() ? recs.begin() : --recs.end()),
+    done(recs.empty())
+  { }
+
+  template <typename K, typename V>
+  const typename Cursor<K, V>::Item *next(Cursor<K, V> &cur) {
+    if (cur.done || cur.it == cur.recs.end() ||
+	(cur.limit && cur.count == cur.limit)) {
+      return nullptr;
+    }
+
+    auto &item(*cur.it);
+    auto &k(item.first);
+
+    if ((cur.prefix && !prefix_eq(k, *cur.from, cur.prefix)) ||
+	(cur.to && (cur.dir == SCAN_FWD ? !(k < *cur.to) : k < *cur.to))) {
+      cur.done = true;
+      return nullptr;
+    }
+
+    if (cur.dir == SCAN_FWD) {
+      cur.it++;
+    } else if (cur.it == cur.recs.begin()) {
+      cur.done = true;
+    } else {
+      cur.it--;
+    }
+
+    cur.count++;
+    return &item;
+  }
+
+  template <typename RecT>
+  const Rec<RecT> *get_rec(const Rec<RecT> &rec) { return &rec; }
+
+  template <typename RecT>
+  const Rec<RecT> *get_rec(const Rec<RecT> *rec) { return rec; }
+
+  // Projects items to table records, which index items point to
+  template <typename K, typename V>
+  auto next_rec(Cursor<K, V> &cur) -> decltype(get_rec(cur.it->second)) {
+    auto item(next(cur));
+    return item ? get_rec(item->second) : nullptr;
+  }
+
+  template <typename K, typename V>
+  Cursor<K, V> scan(const BTree<K, V> &recs, ScanDir dir=SCAN_FWD) {
+    return Cursor<K, V>(recs, dir);
+  }
+
+  template <typename RecT, typename...KeyT>
+  Cursor<typename KeyIndex<RecT, KeyT...>::Key::Type, const Rec<RecT> *>
+  scan(const KeyIndex<RecT, KeyT...> &idx, ScanDir dir=SCAN_FWD) {
+    return scan(idx.recs, dir);
+  }
+}}
+
+#endif
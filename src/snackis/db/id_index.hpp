@@ -0,0 +1,37 @@
+#ifndef SNACKIS_DB_ID_INDEX_HPP
+#define SNACKIS_DB_ID_INDEX_HPP
+
+#include <tuple>
+#include <vector>
+
+#include "snackis/core/uid.hpp"
+#include "snackis/db/cursor.hpp"
+#include "snackis/db/index.hpp"
+
+namespace snackis {
+namespace db {
+  // Ids sort like their hex representation, which allows resolving
+  // prefixes with a single seek
+  template <typename RecT>
+  using IdIndex = KeyIndex<RecT, UId>;
+
+  // Returns records with ids starting with hex prefix, ordered by id
+  template <typename RecT>
+  std::vector<const Rec<RecT> *> find_prefix(const IdIndex<RecT> &idx,
+					     const str &prefix) {
+    std::vector<const Rec<RecT> *> out;
+    auto rng(parse_uid_prefix(prefix));
+    if (!rng) { return out; }
+    auto cur(scan(idx));
+    seek(cur, std::make_tuple(rng->first));
+
+    while (auto it = next(cur)) {
+      if (rng->second < std::get<0>(it->first)) { break; }
+      out.push_back(it->second);
+    }
+    
+    return out;
+  }
+}}
+
+#endif
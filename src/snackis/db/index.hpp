@@ -1,46 +1,76 @@
 #ifndef SNACKIS_DB_INDEX_HPP
 #define SNACKIS_DB_INDEX_HPP
 
-#include "snackis/db/basic_table.hpp"
+#include "snackis/core/btree.hpp"
+#include "snackis/db/key.hpp"
 #include "snackis/db/rec.hpp"
-#include "snackis/db/schema.hpp"
 
-namespace snackis {  
+namespace snackis {
 namespace db {
+  // Indexes are kept in memory and maintained by their table, records
+  // passed in are the ones stored in the table and need stable addresses,
+  // which only holds for tables keyed on a single UId
   template <typename RecT>
-  struct Index: BasicTable, Schema<RecT> {
-    Index(Ctx &ctx, const str &name, const Schema<RecT> &cols);
+  struct Index {
+    virtual ~Index();
+    virtual void insert(const Rec<RecT> &rec) = 0;
+    virtual void erase(const Rec<RecT> &rec) = 0;
+    virtual void clear() = 0;
+  };
+
+  // Maps key tuples to table records
+  template <typename RecT, typename...KeyT>
+  struct KeyIndex: Index<RecT> {
+    using Key = db::Key<RecT, KeyT...>;
+    using Recs = BTree<typename Key::Type, const Rec<RecT> *>;
+
+    const Key key;
+    Recs recs;
 
-    virtual bool insert(const Rec<RecT> &rec) = 0;
-    virtual bool update(const Rec<RecT> &rec, const Rec<RecT> &key) = 0;
-    virtual bool erase(const Rec<RecT> &rec) = 0;
+    KeyIndex(const Key &key);
+    void insert(const Rec<RecT> &rec) override;
+    void erase(const Rec<RecT> &rec) override;
+    void clear() override;
   };
 
   template <typename RecT>
-  Index<RecT>::Index(Ctx &ctx, const str &name, const Schema<RecT> &cols):
-    BasicTable(ctx, name),
-    Schema<RecT>(cols)
+  Index<RecT>::~Index()
   { }
 
   template <typename RecT>
-  bool insert(Index<RecT> &idx, const Rec<RecT> &rec) {
-    return idx.insert(rec);
+  void insert(Index<RecT> &idx, const Rec<RecT> &rec) {
+    idx.insert(rec);
   }
 
   template <typename RecT>
-  bool update(Index<RecT> &idx, const Rec<RecT> &rec, const Rec<RecT> &key) {
-    return idx.update(rec, key);
+  void erase(Index<RecT> &idx, const Rec<RecT> &rec) {
+    idx.erase(rec);
   }
 
   template <typename RecT>
-  bool update(Index<RecT> &idx, const Rec<RecT> &rec) {
-    return idx.update(rec);
+  void clear(Index<RecT> &idx) {
+    idx.clear();
   }
 
-  template <typename RecT>
-  bool erase(Index<RecT> &idx, const Rec<RecT> &rec) {
-    return idx.erase(rec);
-  }  
+  template <typename RecT, typename...KeyT>
+  KeyIndex<RecT, KeyT...>::KeyIndex(const Key &key):
+    key(key)
+  { }
+
+  template <typename RecT, typename...KeyT>
+  void KeyIndex<RecT, KeyT...>::insert(const Rec<RecT> &rec) {
+    recs.emplace(key(rec), &rec);
+  }
+
+  template <typename RecT, typename...KeyT>
+  void KeyIndex<RecT, KeyT...>::erase(const Rec<RecT> &rec) {
+    recs.erase(key(rec));
+  }
+
+  template <typename RecT, typename...KeyT>
+  void KeyIndex<RecT, KeyT...>::clear() {
+    recs.clear();
+  }
 }}
 
 #endif
@@ -31,8 +31,8 @@ namespace db {
   typename Key<RecT, KeyT...>::Type
   Key<RecT, KeyT...>::operator ()(const db::Rec<RecT> &rec) const {
     return map([this, &rec](auto c) {
-	auto fnd(rec.find(c));
-	return (fnd == rec.end()) ? c->type.null : c->type.from_val(fnd->second);
+	auto fnd(find(rec, *c));
+	return fnd ? c->type.from_val(*fnd) : c->type.null;
       },
       *this);
   }
@@ -57,8 +57,8 @@ namespace db {
   template <typename RecT, typename...KeyT>
   void copy(const Key<RecT, KeyT...> &key, Rec<RecT> &dest, const Rec<RecT> &src) {
     for_each(key, [&dest, &src](auto c) {
-	auto found = src.find(c);
-	if (found != src.end()) { dest[c] = found->second; }
+	auto found(find(src, *c));
+	if (found) { set(dest, *c, *found); }
       });
   }
 }}
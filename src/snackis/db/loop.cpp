@@ -4,16 +4,21 @@ namespace snackis {
 namespace db {
   static void run(Loop *lp) {
     while (true) {
-      TRY(try_msg);
-      auto msg(get(lp->inbox));
-      if (!msg) { break; }
-      lp->on_msg(*msg);
+      lp->batch.clear();
+      lp->next = 0;
+      if (!drain(lp->inbox, lp->batch, lp->inbox.max)) { break; }
+      
+      while (lp->next < lp->batch.size()) {
+	TRY(try_msg);
+	lp->on_msg(lp->batch[lp->next++]);
+      }
     }
   }
 		   
   Loop::Loop(Proc &proc, size_t max_buf):
     proc(proc),
-    inbox(max_buf)
+    inbox(max_buf),
+    next(0)
   { }
   
   void start(Loop &lp) {
@@ -24,4 +29,9 @@ namespace db {
     close(lp.inbox);
     lp.thread.join();
   }
+
+  opt<Msg> get(Loop &lp, const std::chrono::steady_clock::time_point &deadline) {
+    if (lp.next < lp.batch.size()) { return std::move(lp.batch[lp.next++]); }
+    return get(lp.inbox, deadline);
+  }
 }}
@@ -1,7 +1,9 @@
 #ifndef SNACKIS_DB_LOOP_HPP
 #define SNACKIS_DB_LOOP_HPP
 
+#include <chrono>
 #include <thread>
+#include <vector>
 #include "snackis/core/chan.hpp"
 #include "snackis/db/msg.hpp"
 
@@ -11,15 +13,21 @@ namespace db {
   
   struct Loop {
     Proc &proc;
-    Chan<Msg> inbox;
+    Chan<Msg, CHAN_MULTI, CHAN_SINGLE> inbox;
+    // Messages drained from inbox in one go, handled in order from next
+    std::vector<Msg> batch;
+    size_t next;
     std::thread thread;
     
     Loop(Proc &proc, size_t max_buf);
-    virtual void on_msg(const Msg &msg)=0;
+    virtual void on_msg(Msg &msg)=0;
   };
 
   void start(Loop &lp);
   void stop(Loop &lp);
+
+  // Returns the next drained message, or waits for one until deadline
+  opt<Msg> get(Loop &lp, const std::chrono::steady_clock::time_point &deadline);
 }}
 
 #endif
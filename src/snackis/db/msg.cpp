@@ -3,8 +3,10 @@
 namespace snackis {
 namespace db {
   const MsgFld<Changes> Msg::CHANGES("changes");
+  const MsgFld<Path> Msg::PATH("path");
   const MsgFld<int64_t> Msg::RECLAIMED("reclaimed");
   const MsgFld<Ctx *> Msg::SENDER("sender");
+  const MsgFld<int64_t> Msg::TIME("time");
 
   BasicMsgFld::BasicMsgFld(const str id):
     id(id)
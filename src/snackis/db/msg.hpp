@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "snackis/core/error.hpp"
+#include "snackis/core/path.hpp"
 #include "snackis/db/change.hpp"
 
 namespace snackis {
@@ -27,16 +28,17 @@ namespace db {
     BasicMsgFld(id)
   { }
 
-  enum MsgType { MSG_CONNECT, MSG_DISCONNECT,
-		 MSG_COMMIT, MSG_REFRESH, MSG_REWRITE,
+  enum MsgType { MSG_COMMIT, MSG_REWRITE, MSG_COMPACTED, MSG_SYNC, MSG_WAIT,
 		 MSG_OK, MSG_ERROR };
 
   struct Msg {
-    using Val = std::variant<int64_t, Ctx *, Changes>;
+    using Val = std::variant<int64_t, Ctx *, Changes, Path>;
 
     static const MsgFld<Changes> CHANGES;
+    static const MsgFld<Path> PATH;
     static const MsgFld<int64_t> RECLAIMED;
     static const MsgFld<Ctx *> SENDER;
+    static const MsgFld<int64_t> TIME;
     
     const MsgType type;
     std::map<const BasicMsgFld *, Val> vals;
@@ -1,3 +1,4 @@
+#include <fstream>
 #include "snackis/snackis.hpp"
 #include "snackis/db/ctx.hpp"
 #include "snackis/db/error.hpp"
@@ -5,6 +6,39 @@
 
 namespace snackis {
 namespace db {
+  static bool write_db_rev(Proc &proc) {
+    const Path p(proc.path / "rev");
+    std::ofstream out;
+    out.open(p.string(), std::ios::out | std::ios::trunc | std::ios::binary);
+    out.write(reinterpret_cast<const char *>(&DB_REV), sizeof(DB_REV));
+    out.close();
+
+    if (out.fail() || !sync_path(p)) {
+      ERROR(Db, "Failed writing database revision");
+      return false;
+    }
+    
+    proc.rev = DB_REV;
+    return true;
+  }
+
+  // Finishes renames interrupted after the revision was written,
+  // leftovers from an unfinished upgrade are discarded
+  static void finish_upgrade(Proc &proc) {
+    for (auto &e: PathIter(proc.path)) {
+      const Path p(e.path());
+      if (p.extension() != ".upgrade") { continue; }
+
+      if (proc.rev == DB_REV) {
+	Path dest(p);
+	rename_path(p, dest.replace_extension());
+      } else {
+	remove_path(p);
+      }
+    }
+  }
+  
+  
   static bool init_db_rev(Proc &proc) {
     const Path p(proc.path / "rev");
     
@@ -15,20 +49,24 @@ namespace db {
       in.read(reinterpret_cast<char *>(&rev), sizeof rev);
       in.close();
 
-      if (rev < DB_REV) {
+      if (rev < MIN_DB_REV) {
 	ERROR(Db, fmt("This version of Snackis requires database revision #%0 to run",
-		      DB_REV));
+		      MIN_DB_REV));
 	return false;
       }
 
+      if (rev > DB_REV) {
+	ERROR(Db, fmt("Database revision #%0 is newer than supported revision #%1",
+		      rev, DB_REV));
+	return false;
+      }
+
+      proc.rev = rev;
+      finish_upgrade(proc);
       return true;
     }
     
-    std::ofstream out;
-    out.open(p.string(), std::ios::out | std::ios::trunc | std::ios::binary);
-    out.write(reinterpret_cast<const char *>(&DB_REV), sizeof(DB_REV));
-    out.close();
-
+    write_db_rev(proc);
     log(proc, "Initialized database, revision %0", DB_REV);
     return true;
   }
@@ -36,8 +74,16 @@ namespace db {
   Proc::Proc(const Path &p, size_t max_buf):
     Loop(*this, max_buf),
     path(p),
-    write_loop(*this, max_buf),
-    change_loop(*this, max_buf)
+    rev(-1),
+    map_files(true),
+    compact_ratio(.5),
+    compact_size(1024*1024),
+    snapshot_size(4*1024*1024),
+    page_size(16*1024),
+    durability(DURABLE_FLUSH),
+    group_window(0),
+    group_size(1024*1024),
+    write_loop(*this, max_buf)
   {
     create_path(path);
     init_db_rev(*this);
@@ -48,27 +94,21 @@ namespace db {
     stop(*this);
   }
   
-  void Proc::on_msg(const Msg &msg) {
-    auto ctx(get(msg, Msg::SENDER));
-    
+  Path upgrade_path(const Path &p) { return p.string() + ".upgrade"; }
+  
+  bool upgrade_rev(Proc &proc) {
+    if (proc.rev == DB_REV) { return true; }
+    const int64_t prev(proc.rev);
+    if (!write_db_rev(proc)) { return false; }
+    log(proc, "Upgraded database from revision %0 to %1", prev, DB_REV);
+    return true;
+  }
+  
+  void Proc::on_msg(Msg &msg) {
     switch (msg.type) {
-    case MSG_CONNECT:
-      put(ctx->inbox, Msg(MSG_OK));      
-      put(change_loop.inbox, msg);
-      break;
-    case MSG_DISCONNECT:
-      put(ctx->inbox, Msg(MSG_OK));      
-      put(change_loop.inbox, msg);
-      break;
-    case MSG_COMMIT:
-      put(write_loop.inbox, msg);
-      put(change_loop.inbox, msg);
-      break;
-    case MSG_REFRESH:
-      put(change_loop.inbox, msg);
-      break;      
     case MSG_REWRITE:
-      put(write_loop.inbox, msg);
+    case MSG_SYNC:
+      put(write_loop.inbox, std::move(msg));
       break;
     default:
       log(*this, "Invalid message type: %0", msg.type);
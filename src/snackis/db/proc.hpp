@@ -1,25 +1,56 @@
 #ifndef SNACKIS_DB_PROC_HPP
 #define SNACKIS_DB_PROC_HPP
 
+#include <atomic>
 #include "snackis/core/path.hpp"
-#include "snackis/db/change_loop.hpp"
+#include "snackis/db/change_feed.hpp"
 #include "snackis/db/write_loop.hpp"
 
 namespace snackis {
 namespace db {
+  // First revisions using varint encoded integers and column ordinals
+  const int64_t VARINT_REV(4), ORDINAL_REV(5);
+
+  // When committed changes reach the disk:
+  // not until group_size bytes are pending, at the end of each group,
+  // synced at the end of each group or synced after each commit
+  enum Durability {DURABLE_NONE, DURABLE_FLUSH, DURABLE_GROUP, DURABLE_COMMIT};
+  
   struct Proc: Loop {
     using Logger = func<void (const str &)>;
 
     const Path path;
+    int64_t rev;
+    bool map_files;
+    // Tables are compacted once dead bytes exceed compact_ratio of
+    // their size, files smaller than compact_size are left alone
+    double compact_ratio;
+    int64_t compact_size;
+    // Table snapshots are written once snapshot_size bytes were logged
+    // since the previous one
+    int64_t snapshot_size;
+    // Records of encrypted tables are sealed together in pages of about
+    // page_size bytes, 0 encrypts each record separately
+    std::atomic<size_t> page_size;
+    // Commits arriving within group_window usecs are written together,
+    // up to group_size pending bytes
+    std::atomic<Durability> durability;
+    int64_t group_window;
+    size_t group_size;
     WriteLoop write_loop;
-    ChangeLoop change_loop;
+    ChangeFeed feed;
     opt<Logger> logger;
 
     Proc(const Path &p, size_t max_buf);
     ~Proc();
-    void on_msg(const Msg &msg) override;
+    void on_msg(Msg &msg) override;
   };
 
+  // Upgraded tables are written next to the originals and renamed into
+  // place once the new revision is on disk
+  Path upgrade_path(const Path &p);
+  bool upgrade_rev(Proc &proc);
+  
   template <typename...Args>
   void log(const Proc &p, const str &spec, const Args&...args) {
     if (p.logger) { (*p.logger)(fmt(spec, args...)); }
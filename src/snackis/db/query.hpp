@@ -0,0 +1,178 @@
+#ifndef SNACKIS_DB_QUERY_HPP
+#define SNACKIS_DB_QUERY_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "snackis/core/func.hpp"
+#include "snackis/core/opt.hpp"
+#include "snackis/core/str.hpp"
+#include "snackis/db/col.hpp"
+#include "snackis/db/cursor.hpp"
+#include "snackis/db/rec.hpp"
+#include "snackis/db/tag_index.hpp"
+#include "snackis/db/text_index.hpp"
+
+namespace snackis {
+namespace db {
+  // Sources are ranked by how narrow they are, the query keeps the highest
+  // ranked source offered and the smallest of matched sources
+  enum SourceRank {SOURCE_ALL, SOURCE_RANGE, SOURCE_PREFIX, SOURCE_MATCH};
+
+  // Queries filter stored records before anything is materialized, and
+  // stop once limit records have been found
+  template <typename RecT>
+  struct Query {
+    using Pred = func<bool (const Rec<RecT> &)>;
+    using Source = func<const Rec<RecT> *()>;
+
+    std::vector<Pred> preds;
+    opt<Source> source;
+    SourceRank rank;
+    size_t count, limit;
+
+    Query();
+  };
+
+  template <typename RecT>
+  Query<RecT>::Query():
+    rank(SOURCE_ALL), count(SIZE_MAX), limit(0)
+  { }
+
+  template <typename RecT, typename K>
+  void from(Query<RecT> &q, const Cursor<K, const Rec<RecT> *> &cur,
+	    SourceRank rank) {
+    if (q.source && rank <= q.rank) { return; }
+    q.source.emplace([c = cur]() mutable { return next_rec(c); });
+    q.rank = rank;
+    q.count = SIZE_MAX;
+  }
+
+  // Sources matched records in the order of idx
+  template <typename RecT, typename...KeyT>
+  void from(Query<RecT> &q, const KeyIndex<RecT, KeyT...> &idx,
+	    const std::vector<const Rec<RecT> *> &recs, ScanDir dir,
+	    SourceRank rank) {
+    if (q.source &&
+	(rank < q.rank || (rank == q.rank && recs.size() >= q.count))) {
+      return;
+    }
+    
+    using Key = typename KeyIndex<RecT, KeyT...>::Key::Type;
+    std::vector<std::pair<Key, const Rec<RecT> *>> keys;
+    keys.reserve(recs.size());
+    for (auto r: recs) { keys.emplace_back(idx.key(*r), r); }
+
+    std::sort(keys.begin(), keys.end(), [dir](auto &x, auto &y) {
+	return (dir == SCAN_FWD) ? x.first < y.first : y.first < x.first;
+      });
+
+    auto ks(std::make_shared<decltype(keys)>(std::move(keys)));
+
+    q.source.emplace([ks, i = size_t(0)]() mutable {
+	return (i < ks->size()) ? (*ks)[i++].second : nullptr;
+      });
+
+    q.rank = rank;
+    q.count = ks->size();
+  }
+
+  // Sources records matching terms in text through idx, text without
+  // terms is left to predicates
+  template <typename RecT, typename...KeyT>
+  void match(Query<RecT> &q, const TextIndex<RecT> &idx,
+	     const KeyIndex<RecT, KeyT...> &order, const str &text,
+	     ScanDir dir) {
+    if (term_set(text).empty()) { return; }
+    from(q, order, match(idx, text), dir, SOURCE_MATCH);
+  }
+
+  template <typename RecT, typename...KeyT>
+  void tagged(Query<RecT> &q, TagIndex<RecT> &idx,
+	      const KeyIndex<RecT, KeyT...> &order, const std::set<str> &tags,
+	      ScanDir dir) {
+    if (tags.empty()) { return; }
+    from(q, order, find(idx, tags), dir, SOURCE_MATCH);
+  }
+
+  template <typename RecT>
+  void filter(Query<RecT> &q, const typename Query<RecT>::Pred &pred) {
+    q.preds.push_back(pred);
+  }
+
+  template <typename RecT>
+  std::vector<const Rec<RecT> *> run(const Query<RecT> &q) {
+    std::vector<const Rec<RecT> *> out;
+    if (!q.source) { return out; }
+    auto src(*q.source);
+
+    while (!q.limit || out.size() < q.limit) {
+      auto rec(src());
+      if (!rec) { break; }
+
+      if (std::all_of(q.preds.begin(), q.preds.end(),
+		      [rec](auto &p) { return p(*rec); })) {
+	out.push_back(rec);
+      }
+    }
+
+    return out;
+  }
+
+  // Returns stored value without copying, or nullptr if missing; only
+  // valid for types stored as is
+  template <typename RecT, typename ValT>
+  const ValT *peek(const Rec<RecT> &rec, const Col<RecT, ValT> &col) {
+    auto found(find(rec, col));
+    return found ? &std::get<ValT>(*found) : nullptr;
+  }
+
+  template <typename RecT, typename ValT>
+  void eq(Query<RecT> &q, const Col<RecT, ValT> &col, const ValT &val) {
+    filter(q, [&col, val](auto &rec) { return get_val(rec, col) == val; });
+  }
+
+  // Bounds are inclusive
+  template <typename RecT, typename ValT>
+  void range(Query<RecT> &q, const Col<RecT, ValT> &col,
+	     const opt<ValT> &min, const opt<ValT> &max) {
+    if (!min && !max) { return; }
+
+    filter(q, [&col, min, max](auto &rec) {
+	auto v(get_val(rec, col));
+	return (!min || !(v < *min)) && (!max || !(*max < v));
+      });
+  }
+
+  template <typename RecT, typename ValT>
+  void has_all(Query<RecT> &q, const Col<RecT, std::set<ValT>> &col,
+	       const std::set<ValT> &vals) {
+    if (vals.empty()) { return; }
+
+    filter(q, [&col, vals](auto &rec) {
+	auto v(get_val(rec, col));
+	return std::includes(v.begin(), v.end(), vals.begin(), vals.end());
+      });
+  }
+
+  // Matches case insensitive text in any of cols
+  template <typename RecT>
+  void contains(Query<RecT> &q,
+		std::initializer_list<const Col<RecT, str> *> cols,
+		const str &text) {
+    if (text.empty()) { return; }
+    std::vector<const Col<RecT, str> *> cs(cols);
+
+    filter(q, [cs, text](auto &rec) {
+	return std::any_of(cs.begin(), cs.end(), [&rec, &text](auto c) {
+	    auto v(peek(rec, *c));
+	    return v && find_ci(*v, text) != str::npos;
+	  });
+      });
+  }
+}}
+
+#endif
@@ -1,8 +1,8 @@
 #ifndef SNACKIS_DB_REC_HPP
 #define SNACKIS_DB_REC_HPP
 
-#include <map>
 #include <string>
+#include <vector>
 
 #include "snackis/core/int64_type.hpp"
 #include "snackis/core/opt.hpp"
@@ -21,41 +21,87 @@ namespace db {
   template <typename RecT>
   struct Schema;
 
+  // Columns are numbered per record type in order of construction
+  const size_t MAX_COLS(64);
+
+  template <typename RecT>
+  std::vector<const BasicCol<RecT> *> &rec_cols();
+  
+  // Values are stored by column ordinal, present has a bit per assigned slot
   template <typename RecT>
-  struct Rec: std::map<const BasicCol<RecT> *, Val> {
+  struct Rec {
+    uint64_t present;
+    std::vector<Val> vals;
+    
     Rec();
     Rec(const Schema<RecT> &scm, const RecT &src);
     Rec(const Schema<RecT> &scm, const Rec<RecT> &src);
   };
 
   template <typename RecT>
-  Rec<RecT>::Rec()
+  Rec<RecT>::Rec():
+    present(0)
   { }
 
   template <typename RecT>
-  Rec<RecT>::Rec(const Schema<RecT> &scm, const RecT &src) {
+  Rec<RecT>::Rec(const Schema<RecT> &scm, const RecT &src):
+    present(0) {
     copy(scm, *this, src);
   }
 
   template <typename RecT>
-  Rec<RecT>::Rec(const Schema<RecT> &scm, const Rec<RecT> &src) {
+  Rec<RecT>::Rec(const Schema<RecT> &scm, const Rec<RecT> &src):
+    present(0) {
     copy(scm, *this, src);
   }
 
+  template <typename RecT>
+  bool empty(const Rec<RecT> &rec) { return !rec.present; }
+
+  template <typename RecT>
+  size_t size(const Rec<RecT> &rec) { return __builtin_popcountll(rec.present); }
+
+  template <typename RecT>
+  void clear(Rec<RecT> &rec) {
+    rec.present = 0;
+    rec.vals.clear();
+  }
+
+  template <typename RecT>
+  const Val *find(const Rec<RecT> &rec, const BasicCol<RecT> &col) {
+    return (rec.present & (uint64_t(1) << col.ord)) ? &rec.vals[col.ord] : nullptr;
+  }
+  
+  template <typename RecT>
+  void set(Rec<RecT> &rec, const BasicCol<RecT> &col, Val &&val) {
+    if (rec.vals.size() <= col.ord) { rec.vals.resize(col.ord+1); }
+    rec.vals[col.ord] = std::move(val);
+    rec.present |= uint64_t(1) << col.ord;
+  }
+
+  template <typename RecT>
+  void set(Rec<RecT> &rec, const BasicCol<RecT> &col, const Val &val) {
+    set(rec, col, Val(val));
+  }
+
   template <typename RecT, typename ValT>
   opt<ValT> get(const Rec<RecT> &rec, const Col<RecT, ValT> &col) {
-    auto found(rec.find(&col));
-    return (found == rec.end()) ? nullopt : opt<ValT>(get<ValT>(found->second));
+    auto found(find(rec, col));
+    return found ? opt<ValT>(get<ValT>(*found)) : nullopt;
   }
 
   template <typename RecT, typename ValT>
   void set(Rec<RecT> &rec, const Col<RecT, ValT> &col, const ValT &val) {
-    rec[&col] = val;
+    set(rec, col, Val(val));
   }
 
   template <typename RecT>
   void copy(RecT &dest, const db::Rec<RecT> &src) {
-    for (auto &f: src) { f.first->set(dest, f.second); }
+    auto &cols(rec_cols<RecT>());
+    
+    for (size_t i(0); i < src.vals.size(); i++) {
+      if (src.present & (uint64_t(1) << i)) { cols[i]->set(dest, src.vals[i]); }
+    }
   }
 
   template <typename RecT>
@@ -70,12 +116,15 @@ namespace db {
 	int64_type.write(edata.size(), out);
 	out.write((char *)&edata[0], edata.size());
     } else {
-      int64_type.write(rec.size(), out);
-    
-      for (auto f: rec) {
-	auto c(f.first);
-	str_type.write(c->name, out);
-	c->write(f.second, out);
+      int64_type.write(size(rec), out);
+      auto &cols(rec_cols<RecT>());
+      
+      for (size_t i(0); i < rec.vals.size(); i++) {
+	if (rec.present & (uint64_t(1) << i)) {
+	  auto c(cols[i]);
+	  str_type.write(c->name, out);
+	  c->write(rec.vals[i], out);
+	}
       }
     }
   }
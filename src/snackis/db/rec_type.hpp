@@ -22,7 +22,7 @@ namespace db {
 
   template <typename RecT>
   bool RecType<RecT>::is_null(const Rec<RecT> &val) const {
-    return val.empty();
+    return db::empty(val);
   }
 
   template <typename RecT>
@@ -2,6 +2,7 @@
 #define SNACKIS_DB_SCHEMA_HPP
 
 #include <initializer_list>
+#include <map>
 #include <vector>
 
 #include "snackis/core/int64_type.hpp"
@@ -9,6 +10,7 @@
 #include "snackis/core/str_type.hpp"
 #include "snackis/crypt/secret.hpp"
 #include "snackis/db/basic_col.hpp"
+#include "snackis/db/error.hpp"
 #include "snackis/db/rec.hpp"
 
 namespace snackis {
@@ -21,6 +23,10 @@ namespace db {
     Schema(Cols cols);
   };
 
+  // Maps column ordinals in table files to columns
+  template <typename RecT>
+  using ColDict = std::vector<const BasicCol<RecT> *>;
+  
   template <typename RecT>
   Schema<RecT>::Schema(Cols cols) {
     for (auto c: cols) { add(*this, *c); }
@@ -47,12 +53,10 @@ namespace db {
   template <typename RecT>
   int compare(const Schema<RecT> &scm, const Rec<RecT> &x, const Rec<RecT> &y) {
     for (auto c: scm.cols) {
-      auto xi = x.find(c);
-      auto yi = y.find(c);
-
-      if (xi == x.end() && yi == y.end()) { continue; }
-      if (xi == x.end()) { return 1; }
-      if (yi == y.end()) { return -1; }
+      auto xi(find(x, *c)), yi(find(y, *c));
+      if (!xi && !yi) { continue; }
+      if (!xi) { return 1; }
+      if (!yi) { return -1; }
 
       if (*xi < *yi) { return -1; }
       if (*yi < *xi) { return 1; }
@@ -79,8 +83,8 @@ namespace db {
   template <typename RecT>
   void copy(const Schema<RecT> &scm, Rec<RecT> &dest, const Rec<RecT> &src) {
     for (auto c: scm.cols) {
-      auto found = src.find(c);
-      if (found != src.end()) { dest[c] = found->second; }
+      auto found(find(src, *c));
+      if (found) { set(dest, *c, *found); }
     }
   }
 
@@ -91,24 +95,107 @@ namespace db {
 	    opt<crypt::Secret> sec) {
     if (sec) {
       int64_t size(int64_type.read(in));
+      if (in.fail() || size < 0) { return; }
       Data edata(size);
       in.read((char *)&edata[0], size);
+      if (in.fail()) { return; }
       const Data ddata(decrypt(*sec, (unsigned char *)&edata[0], size));
       Stream buf(str(ddata.begin(), ddata.end()));
       read(scm, buf, rec, nullopt);
     } else {
       int64_t cnt(int64_type.read(in));
 
-      for (int64_t i=0; i<cnt; i++) {
+      for (int64_t i=0; i<cnt && !in.fail(); i++) {
 	const str cname(str_type.read(in));
 	auto found(scm.col_lookup.find(cname));
 	
 	if (found != scm.col_lookup.end()) {
 	  auto c = found->second;
-	  rec[c] = c->read(in);
+	  set(rec, *c, c->read(in));
+	}
+      }
+    }
+  }  
+
+  template <typename RecT>
+  void write_dict(const Schema<RecT> &scm, std::ostream &out) {
+    int64_type.write(scm.cols.size(), out);
+    for (auto c: scm.cols) { str_type.write(c->name, out); }
+  }
+
+  template <typename RecT>
+  ColDict<RecT> read_dict(const Schema<RecT> &scm, std::istream &in) {
+    const int64_t len(int64_type.read(in));
+    if (in.fail() || len < 0) { return ColDict<RecT>(); }
+    ColDict<RecT> out(len, nullptr);
+
+    for (auto &c: out) {
+      auto found(scm.col_lookup.find(str_type.read(in)));
+      if (found != scm.col_lookup.end()) { c = found->second; }
+    }
+
+    return out;
+  }
+  
+  template <typename RecT>
+  void write(const Schema<RecT> &scm,
+	     const Rec<RecT> &rec,
+	     std::ostream &out,
+	     opt<crypt::Secret> sec) {
+    if (sec) {
+      Stream buf;
+      write(scm, rec, buf, nullopt);
+      str data(buf.str());
+      const Data edata(encrypt(*sec, (unsigned char *)data.c_str(), data.size()));
+      int64_type.write(edata.size(), out);
+      out.write((char *)&edata[0], edata.size());
+    } else {
+      int64_t cnt(0);
+      for (auto c: scm.cols) { if (find(rec, *c)) { cnt++; } }
+      int64_type.write(cnt, out);
+      
+      for (size_t i(0); i < scm.cols.size(); i++) {
+	auto c(scm.cols[i]);
+	auto found(find(rec, *c));
+	
+	if (found) {
+	  int64_type.write(i, out);
+	  c->write(*found, out);
 	}
       }
     }
+  }
+
+  template <typename RecT>
+  void read(const ColDict<RecT> &dict,
+	    std::istream &in,
+	    Rec<RecT> &rec,
+	    opt<crypt::Secret> sec) {
+    if (sec) {
+      int64_t size(int64_type.read(in));
+      if (in.fail() || size < 0) { return; }
+      Data edata(size);
+      in.read((char *)&edata[0], size);
+      if (in.fail()) { return; }
+      const Data ddata(decrypt(*sec, (unsigned char *)&edata[0], size));
+      Stream buf(str(ddata.begin(), ddata.end()));
+      read(dict, buf, rec, nullopt);
+    } else {
+      int64_t cnt(int64_type.read(in));
+
+      for (int64_t i=0; i<cnt && !in.fail(); i++) {
+	const int64_t ord(int64_type.read(in));
+	if (in.fail()) { return; }
+	
+	if (ord < 0 || ord >= int64_t(dict.size()) || !dict[ord]) {
+	  ERROR(Db, fmt("Unknown column: %0", ord));
+	  return;
+	}
+	
+	auto c(dict[ord]);
+	set(rec, *c, c->read(in));
+      }
+    }
   }  
 }}
 
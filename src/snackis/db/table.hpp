@@ -2,34 +2,66 @@
 #define SNACKIS_DB_TABLE_HPP
 
 #include <cstdint>
+#include <fstream>
+#include <list>
 #include <set>
 
+#include "snackis/core/btree.hpp"
 #include "snackis/core/data.hpp"
+#include "snackis/core/defer.hpp"
 #include "snackis/core/fmt.hpp"
 #include "snackis/core/func.hpp"
+#include "snackis/core/hash_map.hpp"
 #include "snackis/core/int64_type.hpp"
+#include "snackis/core/mmap.hpp"
 #include "snackis/core/opt.hpp"
+#include "snackis/core/parallel.hpp"
 #include "snackis/core/str_type.hpp"
 #include "snackis/core/type.hpp"
+#include "snackis/core/uid.hpp"
+#include "snackis/core/utils.hpp"
 #include "snackis/core/stream.hpp"
 #include "snackis/crypt/secret.hpp"
+#include "snackis/db/basic_table.hpp"
 #include "snackis/db/change.hpp"
 #include "snackis/db/ctx.hpp"
+#include "snackis/db/cursor.hpp"
 #include "snackis/db/error.hpp"
 #include "snackis/db/index.hpp"
+#include "snackis/db/key.hpp"
 #include "snackis/db/rec.hpp"
+#include "snackis/db/schema.hpp"
 #include "snackis/db/trans.hpp"
 
 namespace snackis {  
 namespace db {
   template <typename RecT, typename...KeyT>
   struct Table;
+
+  struct UIdKeyHash {
+    size_t operator ()(const std::tuple<UId> &key) const {
+      return hash(std::get<0>(key));
+    }
+  };
+  
+  // Storage policy for table records; tables keyed on a single UId are
+  // hashed, keep record addresses stable and share records between copies,
+  // the rest are kept sorted
+  template <typename RecT, typename...KeyT>
+  struct RecStore {
+    using Type = BTree<std::tuple<KeyT...>, Rec<RecT>>;
+  };
+
+  template <typename RecT>
+  struct RecStore<RecT, UId> {
+    using Type = HashMap<std::tuple<UId>, Rec<RecT>, UIdKeyHash>;
+  };
   
   template <typename RecT, typename...KeyT>
-  struct Table: Index<RecT> {
+  struct Table: BasicTable, Schema<RecT> {
     using Key = db::Key<RecT, KeyT...>;
     using Cols = std::initializer_list<const BasicCol<RecT> *>;
-    using Recs = std::map<typename Key::Type, Rec<RecT>>;
+    using Recs = typename RecStore<RecT, KeyT...>::Type;
     using RecIter = typename Recs::iterator;
     using OnInsert = func<void (Rec<RecT> &)>;
     using OnUpdate = func<void (const Rec<RecT> &, Rec<RecT> &)>;
@@ -46,15 +78,12 @@ namespace db {
 	  const Schema<RecT> &cols);
     virtual ~Table();
 
-    bool insert(const Rec<RecT> &rec) override;
-    bool update(const Rec<RecT> &rec, const Rec<RecT> &key) override;
-    bool erase(const Rec<RecT> &rec) override;
-
     void dump(std::ostream &out) override;
+    void write_schema(std::ostream &out) override;
     void slurp() override;
+    int64_t compact(int64_t size, std::ostream &out) override;
   };
     
-  enum TableOp {TABLE_INSERT, TABLE_UPDATE, TABLE_ERASE};
 
   template <typename RecT, typename...KeyT>
   struct TableChange: Change {
@@ -63,8 +92,11 @@ namespace db {
     const Rec<RecT> rec;
 
     TableChange(TableOp op, Table<RecT, KeyT...> &table, const Rec<RecT> &rec);
-    Path table_path() const override;
-    virtual void write(std::ostream &out) const override;
+    BasicTable &base_table() const override;
+    int64_t dead_bytes(int64_t size) const override;
+    void write_schema(std::ostream &out) const override;
+    virtual void write(std::ostream &out,
+		       const opt<crypt::Secret> &sec) const override;
   };
 
   template <typename RecT, typename...KeyT>
@@ -80,11 +112,11 @@ namespace db {
     const Rec<RecT> prev_rec;
     Update(Table<RecT, KeyT...> &table,
 	   const Rec<RecT> &rec,
-	   const Rec<RecT> &prev_rec);    
+	   Rec<RecT> prev_rec);    
     void apply(Ctx &ctx) const override;
     void rollback() const override;
     void undo() const override;
-    void write(std::ostream &out) const override;
+    void write(std::ostream &out, const opt<crypt::Secret> &sec) const override;
   };
 
   template <typename RecT, typename...KeyT>
@@ -149,21 +181,48 @@ namespace db {
     return get(tbl, tbl.key(rec));
   }
 
+  // Only sorted tables can be scanned, tables keyed on a single UId are
+  // scanned through their indexes
+  template <typename RecT, typename...KeyT>
+  Cursor<std::tuple<KeyT...>, Rec<RecT>>
+  scan(const Table<RecT, KeyT...> &tbl, ScanDir dir=SCAN_FWD) {
+    return scan(tbl.recs, dir);
+  }
+
+  template <typename RecT, typename...KeyT>
+  void index(Table<RecT, KeyT...> &tbl, const Rec<RecT> &rec) {
+    for (auto idx: tbl.indexes) { insert(*idx, rec); }
+  }
+
+  template <typename RecT, typename...KeyT>
+  void unindex(Table<RecT, KeyT...> &tbl, const Rec<RecT> &rec) {
+    for (auto idx: tbl.indexes) { erase(*idx, rec); }
+  }
+
+  // Indexes are rebuilt in parallel from scratch
+  template <typename RecT, typename...KeyT>
+  void reindex(Table<RecT, KeyT...> &tbl) {
+    std::vector<Index<RecT> *> idxs(tbl.indexes.begin(), tbl.indexes.end());
+    
+    parallel_for(idxs.size(), [&](size_t i) {
+	auto &idx(*idxs[i]);
+	clear(idx);
+	for (auto &r: tbl.recs) { insert(idx, r.second); }
+      });
+  }
+  
   template <typename RecT, typename...KeyT>
   bool insert(Table<RecT, KeyT...> &tbl, const Rec<RecT> &rec) {
     TRACE(fmt("Inserting into table: %0", tbl.name));
     auto k(tbl.key(rec));
     auto it(tbl.recs.find(k));
     if (it != tbl.recs.end()) { return false; }
-
-    for (auto idx: tbl.indexes) {
-      insert(*idx, rec);
-    }
-
     it = tbl.recs.emplace(k, db::Rec<RecT>()).first;
-    copy(tbl, it->second, rec);
-    for (auto e: tbl.on_insert) { e(it->second); }
-    log_change(get_trans(tbl.ctx), new Insert<RecT, KeyT...>(tbl, it->second));
+    auto &tbl_rec(it->second);
+    copy(tbl, tbl_rec, rec);
+    for (auto &e: tbl.on_insert) { e(tbl_rec); }
+    index(tbl, tbl_rec);
+    log_change<Insert<RecT, KeyT...>>(get_trans(tbl.ctx), tbl, tbl_rec);
     return true;
   }
 
@@ -172,6 +231,7 @@ namespace db {
     return insert(tbl, db::Rec<RecT>(tbl, rec));
   }
 
+  // Leaves the updated record unindexed, callers index once it's final
   template <typename RecT, typename...KeyT>
   opt<std::pair<typename Table<RecT, KeyT...>::RecIter, db::Rec<RecT>>>
   update_rec(Table<RecT, KeyT...> &tbl,
@@ -186,10 +246,12 @@ namespace db {
     
     auto prev(it->second);
     auto rec_key(tbl.key(rec));
+    unindex(tbl, it->second);
     
     if (rec_key == key) {
-      it->second.clear();
-      copy(tbl, it->second, rec);
+      auto &tbl_rec(mut(tbl.recs, it).second);
+      clear(tbl_rec);
+      copy(tbl, tbl_rec, rec);
     } else {
       tbl.recs.erase(it);
       it = tbl.recs.emplace(rec_key, db::Rec<RecT>()).first;
@@ -205,10 +267,12 @@ namespace db {
 	      const typename Key<RecT, KeyT...>::Type &key) {
     auto res(update_rec(tbl, rec, key));
     if (!res) { return false; }
-    auto [it, prev] = *res;
-    for (auto idx: tbl.indexes) { update(*idx, rec, prev); }
-    for (auto e: tbl.on_update) { e(prev, it->second); }
-    log_change(get_trans(tbl.ctx), new Update<RecT, KeyT...>(tbl, it->second, prev));
+    auto &[it, prev] = *res;
+    auto &tbl_rec(it->second);
+    for (auto &e: tbl.on_update) { e(prev, tbl_rec); }
+    index(tbl, tbl_rec);
+    log_change<Update<RecT, KeyT...>>(get_trans(tbl.ctx), tbl, tbl_rec,
+				      std::move(prev));
     return true;
   }
 
@@ -246,8 +310,8 @@ namespace db {
     TRACE(fmt("Erasing from table: %0", tbl.name));
     auto it(tbl.recs.find(key));
     if (it == tbl.recs.end()) { return false; }
-    log_change(get_trans(tbl.ctx), new Erase<RecT, KeyT...>(tbl, it->second));
-    for (auto idx: tbl.indexes) { erase(*idx, it->second); }
+    log_change<Erase<RecT, KeyT...>>(get_trans(tbl.ctx), tbl, it->second);
+    unindex(tbl, it->second);
     tbl.recs.erase(it);
     return true;
   }
@@ -267,24 +331,145 @@ namespace db {
     return erase(tbl, tbl.key(rec));
   }
 
+  template <typename RecT, typename...KeyT>
+  void write_schema(Table<RecT, KeyT...> &tbl, std::ostream &out) {
+    const uint8_t op(TABLE_SCHEMA);
+    out.write(reinterpret_cast<const char *>(&op), sizeof op);
+    write_dict(tbl, out);
+  }
+
   template <typename RecT, typename...KeyT>
   void write(Table<RecT, KeyT...> &tbl, TableOp _op,
 	     const Rec<RecT> &rec,
-	     std::ostream &out) {
+	     std::ostream &out,
+	     const opt<crypt::Secret> &sec) {
     uint8_t op(_op);
     out.write(reinterpret_cast<const char *>(&op), sizeof op);
-    write(rec, out, tbl.ctx.secret);
+    write(tbl, rec, out, sec);
+  }
+
+  template <typename RecT, typename...KeyT>
+  void write(Table<RecT, KeyT...> &tbl, TableOp op,
+	     const Rec<RecT> &rec,
+	     std::ostream &out) {
+    write(tbl, op, rec, out, tbl.ctx.secret);
+  }
+
+  template <typename RecT, typename...KeyT>
+  void dump(Table<RecT, KeyT...> &tbl,
+	    const typename Table<RecT, KeyT...>::Recs &recs,
+	    std::ostream &out) {    
+    write_schema(tbl, out);
+    auto &sec(tbl.ctx.secret);
+    const size_t page_size(tbl.ctx.proc.page_size);
+    
+    if (!sec || !page_size) {
+      for (auto &rec: recs) { write(tbl, TABLE_INSERT, rec.second, out); }
+      return;
+    }
+
+    OutStream page;
+    
+    for (auto &rec: recs) {
+      write(tbl, TABLE_INSERT, rec.second, page, nullopt);
+      
+      if (size_t(page.tellp()) >= page_size) {
+	write_page(*sec, page.str(), out);
+	page.str("");
+      }
+    }
+
+    if (page.tellp() > 0) { write_page(*sec, page.str(), out); }
   }
 
   template <typename RecT, typename...KeyT>
   void dump(Table<RecT, KeyT...> &tbl, std::ostream &out) {    
-    for (auto &rec: tbl.recs) {
-      write(tbl, TABLE_INSERT, rec.second, out);
+    dump(tbl, tbl.recs, out);
+  }
+
+  template <typename RecT, typename...KeyT>
+  void replay(Table<RecT, KeyT...> &tbl,
+	      typename Table<RecT, KeyT...>::Recs &recs,
+	      uint8_t op,
+	      const Rec<RecT> &rec) {
+    switch (op) {
+    case TABLE_INSERT:
+      recs.emplace(tbl.key(rec), rec);
+      break;
+    case TABLE_UPDATE: {
+      auto k(tbl.key(rec));
+      recs.erase(k);
+      recs.emplace(k, rec);
+      break;
+    }
+    case TABLE_ERASE:
+      recs.erase(tbl.key(rec));
+      break;
+    default:
+      log(tbl.ctx, fmt("Invalid table operation: %0", op));
     }
   }
+  
+  template <typename RecT>
+  using PageRecs = std::vector<std::pair<uint8_t, Rec<RecT>>>;
+
+  // Decrypts page and reads its records into out, records without dict
+  // use column names
+  template <typename RecT, typename...KeyT>
+  bool read_page(Table<RecT, KeyT...> &tbl, const ColDict<RecT> *dict,
+		 const unsigned char *data, size_t size,
+		 PageRecs<RecT> &out, int64_t &dead) {
+    if (!tbl.ctx.secret) {
+      ERROR(Db, fmt("Missing secret for page: %0", tbl.name));
+      return false;
+    }
+    
+    Data ddata;
+    if (!decrypt(*tbl.ctx.secret, data, size, ddata)) { return false; }
+    SpanBuf buf(ddata.data(), ddata.size());
+    std::istream in(&buf);
+
+    while (buf.avail()) {
+      const size_t avail(buf.avail());
+      const uint8_t op(*buf.pos());
+      buf.skip(1);
+      Rec<RecT> rec;
+      
+      if (dict) {
+	read(*dict, in, rec, nullopt);
+      } else {
+	read(tbl, in, rec, nullopt);
+      }
+
+      if (in.fail()) {
+	ERROR(Db, fmt("Failed reading: %0", tbl.name));
+	return false;
+      }
 
+      dead += dead_bytes(TableOp(op), avail - buf.avail());
+      out.emplace_back(op, std::move(rec));
+    }
+
+    return true;
+  }
+  
+  // Slurp functions replay records into recs and return the number of
+  // bytes read up to the last complete record and an estimate of how many
+  // of them are dead, a final record with valid op running past the end
+  // is skipped as truncated while any other damage raises an error
+  
   template <typename RecT, typename...KeyT>
-  void slurp(Table<RecT, KeyT...> &tbl, std::istream &in) {    
+  SlurpRes slurp(Table<RecT, KeyT...> &tbl,
+		 typename Table<RecT, KeyT...>::Recs &recs,
+		 std::istream &in) {    
+    const bool prev_decimal(int64_decimal);
+    int64_decimal = tbl.ctx.proc.rev < VARINT_REV;
+    DEFER({ int64_decimal = prev_decimal; });
+    bool ordinals(tbl.ctx.proc.rev >= ORDINAL_REV);
+    ColDict<RecT> dict;
+    const int64_t offs(in.tellg());
+    SlurpRes res;
+    
     while (true) {
       uint8_t op;
       in.read(reinterpret_cast<char *>(&op), sizeof op);
@@ -297,49 +482,333 @@ namespace db {
       if (in.fail()) {
 	in.clear();
 	ERROR(Db, fmt("Failed reading: %0", tbl.name));
+	break;
       }
-            
-      Rec<RecT> rec;
-      read(tbl, in, rec, tbl.ctx.secret);
 
-      switch (op) {
-      case TABLE_INSERT:
-	tbl.recs.emplace(tbl.key(rec), rec);
+      if (op > TABLE_PAGE) {
+	ERROR(Db, fmt("Invalid op %0 in %1 at offset %2", int(op), tbl.name,
+		      res.size));
 	break;
-      case TABLE_UPDATE: {
-	auto k(tbl.key(rec));
-	tbl.recs.erase(k);
-	tbl.recs.emplace(k, rec);
+      }
+      
+      Rec<RecT> rec;
+      Data page;
+      
+      if (op == TABLE_SCHEMA) {
+	dict = read_dict(tbl, in);
+	ordinals = true;
+      } else if (op == TABLE_PAGE) {
+	const int64_t size(int64_type.read(in));
+
+	if (!in.fail() && size >= 0) {
+	  page.resize(size);
+	  in.read(reinterpret_cast<char *>(page.data()), size);
+	} else {
+	  in.setstate(std::ios::failbit);
+	}
+      } else if (ordinals) {
+	read(dict, in, rec, tbl.ctx.secret);
+      } else {
+	read(tbl, in, rec, tbl.ctx.secret);
+      }
+
+      if (in.fail()) {
+	const bool eof(in.eof());
+	in.clear();
+
+	if (eof) {
+	  res.truncated = true;
+	} else {
+	  ERROR(Db, fmt("Failed reading: %0", tbl.name));
+	}
+	
 	break;
       }
-      case TABLE_ERASE:
-	tbl.recs.erase(tbl.key(rec));
+
+      const int64_t end(int64_t(in.tellg()) - offs);
+      
+      if (op == TABLE_PAGE) {
+	PageRecs<RecT> prs;
+	int64_t dead(0);
+	if (!read_page(tbl, ordinals ? &dict : nullptr,
+		       page.data(), page.size(), prs, dead)) { break; }
+	for (auto &r: prs) { replay(tbl, recs, r.first, r.second); }
+	res.dead += dead;
+      } else if (op != TABLE_SCHEMA) {
+	replay(tbl, recs, op, rec);
+	res.dead += dead_bytes(TableOp(op), end - res.size);
+      }
+
+      res.size = end;
+    }
+
+    return res;
+  }
+
+  template <typename RecT, typename...KeyT>
+  void slurp(Table<RecT, KeyT...> &tbl, std::istream &in) {    
+    tbl.dead_bytes = slurp(tbl, tbl.recs, in).dead;
+    reindex(tbl);
+  }
+  
+  // Encrypted records and pages are split sequentially and decoded in
+  // parallel, SLURP_BATCH at a time in chunks of about SLURP_CHUNK bytes
+  const size_t SLURP_BATCH(65536), SLURP_CHUNK(65536);
+
+  // Records without dict use column names
+  template <typename RecT>
+  struct SlurpRec {
+    const uint8_t op;
+    const ColDict<RecT> *dict;
+    const unsigned char *data;
+    const size_t size;
+    Rec<RecT> rec;
+    PageRecs<RecT> page;
+    int64_t dead;
+    
+    SlurpRec(uint8_t op, const ColDict<RecT> *dict,
+	     const unsigned char *data, size_t size):
+      op(op), dict(dict), data(data), size(size), dead(0)
+    { }
+  };
+  
+  template <typename RecT, typename...KeyT>
+  void decode(Table<RecT, KeyT...> &tbl, std::vector<SlurpRec<RecT>> &recs) {
+    const bool decimal(tbl.ctx.proc.rev < VARINT_REV);
+    std::vector<size_t> chunks(1, 0);
+    size_t chunk_size(0);
+    
+    for (size_t i(0); i < recs.size(); i++) {
+      chunk_size += recs[i].size;
+      
+      if (chunk_size >= SLURP_CHUNK || i == recs.size()-1) {
+	chunks.push_back(i+1);
+	chunk_size = 0;
+      }
+    }
+    
+    parallel_for(chunks.size()-1, [&](size_t i) {
+	const bool prev_decimal(int64_decimal);
+	int64_decimal = decimal;
+	DEFER({ int64_decimal = prev_decimal; });
+	SpanBuf buf;
+	std::istream in(&buf);
+	Data ddata;
+
+	for (size_t j(chunks[i]); j < chunks[i+1]; j++) {
+	  auto &r(recs[j]);
+
+	  if (r.op == TABLE_PAGE) {
+	    if (!read_page(tbl, r.dict, r.data, r.size, r.page, r.dead)) { return; }
+	    continue;
+	  }
+	  
+	  if (!decrypt(*tbl.ctx.secret, r.data, r.size, ddata)) { return; }
+	  buf.reset(ddata.data(), ddata.size());
+	  in.clear();
+	  
+	  if (r.dict) {
+	    read(*r.dict, in, r.rec, nullopt);
+	  } else {
+	    read(tbl, in, r.rec, nullopt);
+	  }
+
+	  if (in.fail()) {
+	    ERROR(Db, fmt("Failed reading: %0", tbl.name));
+	    return;
+	  }
+	}
+      });
+  }
+  
+  template <typename RecT, typename...KeyT>
+  SlurpRes slurp(Table<RecT, KeyT...> &tbl,
+		 typename Table<RecT, KeyT...>::Recs &recs,
+		 const unsigned char *data, size_t size) {
+    SpanBuf buf(data, size);
+    std::istream in(&buf);
+    if (!tbl.ctx.secret) { return slurp(tbl, recs, in); }
+
+    TRY(try_slurp);
+    const bool prev_decimal(int64_decimal);
+    int64_decimal = tbl.ctx.proc.rev < VARINT_REV;
+    DEFER({ int64_decimal = prev_decimal; });
+    std::list<ColDict<RecT>> dicts(1);
+    const ColDict<RecT> *dict((tbl.ctx.proc.rev >= ORDINAL_REV)
+			      ? &dicts.back()
+			      : nullptr);
+    std::vector<SlurpRec<RecT>> srecs;
+    srecs.reserve(SLURP_BATCH);
+    SlurpRes res;
+    
+    auto flush([&]() {
+	decode(tbl, srecs);
+	if (!try_slurp.errors.empty()) { return false; }
+	
+	for (auto &r: srecs) {
+	  if (r.op == TABLE_PAGE) {
+	    for (auto &pr: r.page) { replay(tbl, recs, pr.first, pr.second); }
+	    res.dead += r.dead;
+	  } else {
+	    replay(tbl, recs, r.op, r.rec);
+	  }
+	}
+	
+	srecs.clear();
+	return true;
+      });
+    
+    while (buf.avail()) {
+      const uint8_t op(*buf.pos());
+      buf.skip(1);
+
+      if (op > TABLE_PAGE) {
+	ERROR(Db, fmt("Invalid op %0 in %1 at offset %2", int(op), tbl.name,
+		      res.size));
 	break;
-      default:
-	log(tbl.ctx, fmt("Invalid table operation: %0", op));
       }
+      
+      if (op == TABLE_SCHEMA) {
+	ColDict<RecT> d(read_dict(tbl, in));
+	
+	if (in.fail()) {
+	  if (in.eof()) {
+	    res.truncated = true;
+	  } else {
+	    ERROR(Db, fmt("Failed reading: %0", tbl.name));
+	  }
+	  
+	  break;
+	}
+	
+	dicts.push_back(d);
+	dict = &dicts.back();
+	if (!try_slurp.errors.empty()) { return res; }
+      } else {
+	const int64_t esize(int64_type.read(in));
+      
+	if ((in.fail() && in.eof()) ||
+	    (!in.fail() && esize >= 0 && size_t(esize) > buf.avail())) {
+	  res.truncated = true;
+	  break;
+	}
+
+	if (in.fail() || esize < 0) {
+	  ERROR(Db, fmt("Failed reading: %0", tbl.name));
+	  break;
+	}
+
+	srecs.emplace_back(op, dict, buf.pos(), esize);
+	buf.skip(esize);
+	if (op != TABLE_PAGE) {
+	  res.dead += dead_bytes(TableOp(op), buf.pos() - data - res.size);
+	}
+      }
+
+      res.size = buf.pos() - data;
+      if (srecs.size() == SLURP_BATCH && !flush()) { return res; }
     }
+
+    flush();
+    return res;
   }
 
+  template <typename RecT, typename...KeyT>
+  void slurp(Table<RecT, KeyT...> &tbl, const unsigned char *data, size_t size) {
+    tbl.dead_bytes = slurp(tbl, tbl.recs, data, size).dead;
+    reindex(tbl);
+  }
+
+  // Loads the table snapshot if it covers at most size bytes of the log,
+  // returns covered size and dead bytes
+  template <typename RecT, typename...KeyT>
+  std::pair<int64_t, int64_t>
+  slurp_snapshot(Table<RecT, KeyT...> &tbl,
+		 typename Table<RecT, KeyT...>::Recs &recs,
+		 int64_t size) {
+    if (!path_exists(tbl.snap_path)) { return std::make_pair(0, 0); }
+    TRY(try_snap);
+    int64_t snap_size(-1), dead(0);
+
+    {
+      MMap m(tbl.snap_path);
+
+      if (try_snap.errors.empty() &&
+	  read_snapshot_header(m.data, m.size, snap_size, dead) &&
+	  snap_size <= size) {
+	auto res(slurp(tbl, recs,
+		       m.data+SNAPSHOT_HEADER, m.size-SNAPSHOT_HEADER));
+	if (res.truncated) { snap_size = -1; }
+      } else {
+	snap_size = -1;
+      }
+    }
+    
+    if (snap_size == -1 || !try_snap.errors.empty()) {
+      for (auto e: try_snap.errors) { delete e; }
+      try_snap.errors.clear();
+      recs.clear();
+      log(tbl.ctx, "Ignoring invalid snapshot: %0", tbl.name);
+      return std::make_pair(0, 0);
+    }
+
+    return std::make_pair(snap_size, dead);
+  }
+  
   template <typename RecT, typename...KeyT>
   void slurp(Table<RecT, KeyT...> &tbl) {
-    std::fstream f;
+    TRY(try_slurp);
+    const auto snap(slurp_snapshot(tbl, tbl.recs, path_size(tbl.path)));
+    SlurpRes res;
     
-    f.open(get_path(tbl.ctx, tbl.name + ".tbl").string(),
-	      std::ios::in | std::ios::binary);
-    if (f.fail()) {
-      ERROR(Db, fmt("Failed opening file: %0", tbl.name));
-      return;
+    if (tbl.ctx.proc.map_files) {
+      MMap m(tbl.path);
+      if (!try_slurp.errors.empty()) { return; }
+      res = slurp(tbl, tbl.recs, m.data+snap.first, m.size-snap.first);
+    } else {
+      std::fstream f;
+      f.open(tbl.path.string(), std::ios::in | std::ios::binary);
+      
+      if (f.fail()) {
+	ERROR(Db, fmt("Failed opening file: %0", tbl.name));
+	return;
+      }
+
+      f.seekg(snap.first);
+      res = slurp(tbl, tbl.recs, f);
+      f.close();
     }
 
-    slurp(tbl, f);
-    f.close();
+    tbl.dead_bytes = snap.second + res.dead;
+    reindex(tbl);
+
+    if (res.truncated && try_slurp.errors.empty()) {
+      const int64_t size(snap.first + res.size);
+      log(tbl.ctx, "Skipped truncated record in %0 at offset %1",
+	  tbl.name, size);
+      resize_path(tbl.path, size);
+    }
+  }
+
+  template <typename RecT, typename...KeyT>
+  int64_t compact(Table<RecT, KeyT...> &tbl, int64_t size, std::ostream &out) {
+    TRY(try_compact);
+    typename Table<RecT, KeyT...>::Recs recs;
+    const auto snap(slurp_snapshot(tbl, recs, size));
+    MMap m(tbl.path);
+    if (!try_compact.errors.empty()) { return 0; }
+
+    auto res(slurp(tbl, recs,
+		   m.data+snap.first, min(int64_t(m.size), size)-snap.first));
+    if (try_compact.errors.empty()) { dump(tbl, recs, out); }
+    return snap.second + res.dead;
   }
 
   template <typename RecT, typename...KeyT>
   void copy(Table<RecT, KeyT...> &dest, const Table<RecT, KeyT...> &src) {
-    std::copy(src.recs.begin(), src.recs.end(),
-	      std::inserter(dest.recs, dest.recs.end()));
+    copy(dest.recs, src.recs);
+    dest.dead_bytes = src.dead_bytes;
+    reindex(dest);
   }
   
   template <typename RecT, typename...KeyT>
@@ -347,7 +816,8 @@ namespace db {
 			      const str &name,
 			      const Key &key,
 			      const Schema<RecT> &cols):
-    Index<RecT>(ctx, name, cols),
+    BasicTable(ctx, name),
+    Schema<RecT>(cols),
     key(key)
   {
     for_each(key, [this](auto c) { add(*this, *c); });
@@ -356,30 +826,28 @@ namespace db {
 
   template <typename RecT, typename...KeyT>
   Table<RecT, KeyT...>::~Table() {
+    // Pending commits still refer to the table
+    wait_writes(this->ctx);
+    wait_compact(this->ctx.proc.write_loop, *this);
     this->ctx.tables.erase(this->name);
   }
 
   template <typename RecT, typename...KeyT>
-  bool Table<RecT, KeyT...>::insert(const Rec<RecT> &rec) {
-    return db::insert(*this, rec);
-  }
-  
-  template <typename RecT, typename...KeyT>
-  bool Table<RecT, KeyT...>::update(const Rec<RecT> &rec, const Rec<RecT> &key) {
-    return db::update(*this, rec, key);
-  }
-  
+  void Table<RecT, KeyT...>::dump(std::ostream &out) { db::dump(*this, out); }
+
   template <typename RecT, typename...KeyT>
-  bool Table<RecT, KeyT...>::erase(const Rec<RecT> &rec) {
-    return db::erase(*this, rec);
+  void Table<RecT, KeyT...>::write_schema(std::ostream &out) {
+    db::write_schema(*this, out);
   }
-  
-  template <typename RecT, typename...KeyT>
-  void Table<RecT, KeyT...>::dump(std::ostream &out) { db::dump(*this, out); }
 
   template <typename RecT, typename...KeyT>
   void Table<RecT, KeyT...>::slurp() { db::slurp(*this); }
 
+  template <typename RecT, typename...KeyT>
+  int64_t Table<RecT, KeyT...>::compact(int64_t size, std::ostream &out) {
+    return db::compact(*this, size, out);
+  }
+
   template <typename RecT, typename...KeyT>
   TableChange<RecT, KeyT...>::TableChange(TableOp op,
 					  Table<RecT, KeyT...> &table,
@@ -388,13 +856,24 @@ namespace db {
   { }
 
   template <typename RecT, typename...KeyT>
-  Path TableChange<RecT, KeyT...>::table_path() const {
-    return table.path;
+  BasicTable &TableChange<RecT, KeyT...>::base_table() const {
+    return table;
   }
 
   template <typename RecT, typename...KeyT>
-  void TableChange<RecT, KeyT...>::write(std::ostream &out) const {
-    db::write(this->table, this->op, this->rec, out);
+  int64_t TableChange<RecT, KeyT...>::dead_bytes(int64_t size) const {
+    return db::dead_bytes(op, size);
+  }
+
+  template <typename RecT, typename...KeyT>
+  void TableChange<RecT, KeyT...>::write_schema(std::ostream &out) const {
+    db::write_schema(this->table, out);
+  }
+
+  template <typename RecT, typename...KeyT>
+  void TableChange<RecT, KeyT...>::write(std::ostream &out,
+					 const opt<crypt::Secret> &sec) const {
+    db::write(this->table, this->op, this->rec, out, sec);
   }
 
   template <typename RecT, typename...KeyT>
@@ -405,12 +884,17 @@ namespace db {
   template <typename RecT, typename...KeyT>
   void Insert<RecT, KeyT...>::apply(Ctx &ctx) const {
     auto &tbl(get_table<RecT, KeyT...>(ctx, this->table.name));
-    tbl.recs.emplace(tbl.key(this->rec), this->rec);
+    auto res(tbl.recs.emplace(tbl.key(this->rec), this->rec));
+    if (res.second) { index(tbl, res.first->second); }
   }
 
   template <typename RecT, typename...KeyT>
   void Insert<RecT, KeyT...>::rollback() const {
-    this->table.recs.erase(this->table.key(this->rec));
+    auto &tbl(this->table);
+    auto it(tbl.recs.find(tbl.key(this->rec)));
+    if (it == tbl.recs.end()) { return; }
+    unindex(tbl, it->second);
+    tbl.recs.erase(it);
   }
 
   template <typename RecT, typename...KeyT>
@@ -421,20 +905,23 @@ namespace db {
   template <typename RecT, typename...KeyT>
   Update<RecT, KeyT...>::Update(Table<RecT, KeyT...> &table,
 				const Rec<RecT> &rec,
-				const Rec<RecT> &prev_rec):
+				Rec<RecT> prev_rec):
     TableChange<RecT, KeyT...>(TABLE_UPDATE, table, rec),
-    prev_rec(prev_rec)
+    prev_rec(std::move(prev_rec))
   { }
 
   template <typename RecT, typename...KeyT>
   void Update<RecT, KeyT...>::apply(Ctx &ctx) const {
     auto &tbl(get_table<RecT, KeyT...>(ctx, this->table.name));
-    update_rec(tbl, this->rec, tbl.key(this->prev_rec));
+    auto res(update_rec(tbl, this->rec, tbl.key(this->prev_rec)));
+    if (res) { index(tbl, res->first->second); }
   }
 
   template <typename RecT, typename...KeyT>
   void Update<RecT, KeyT...>::rollback() const {
-    update_rec(this->table, this->prev_rec, this->table.key(this->rec));
+    auto &tbl(this->table);
+    auto res(update_rec(tbl, this->prev_rec, tbl.key(this->rec)));
+    if (res) { index(tbl, res->first->second); }
   }
 
   template <typename RecT, typename...KeyT>
@@ -443,12 +930,13 @@ namespace db {
   }
 
   template <typename RecT, typename...KeyT>
-  void Update<RecT, KeyT...>::write(std::ostream &out) const {
+  void Update<RecT, KeyT...>::write(std::ostream &out,
+				    const opt<crypt::Secret> &sec) const {
     if (this->table.key(this->rec) == this->table.key(this->prev_rec)) {
-      TableChange<RecT, KeyT...>::write(out);
+      TableChange<RecT, KeyT...>::write(out, sec);
     } else {
-      db::write(this->table, TABLE_ERASE, this->prev_rec, out);
-      db::write(this->table, TABLE_INSERT, this->rec, out);
+      db::write(this->table, TABLE_ERASE, this->prev_rec, out, sec);
+      db::write(this->table, TABLE_INSERT, this->rec, out, sec);
     }
   }
   
@@ -460,12 +948,17 @@ namespace db {
   template <typename RecT, typename...KeyT>
   void Erase<RecT, KeyT...>::apply(Ctx &ctx) const {
     auto &tbl(get_table<RecT, KeyT...>(ctx, this->table.name));
-    tbl.recs.erase(tbl.key(this->rec));
+    auto it(tbl.recs.find(tbl.key(this->rec)));
+    if (it == tbl.recs.end()) { return; }
+    unindex(tbl, it->second);
+    tbl.recs.erase(it);
   }
 
   template <typename RecT, typename...KeyT>
   void Erase<RecT, KeyT...>::rollback() const {
-    this->table.recs.emplace(this->table.key(this->rec), this->rec);
+    auto &tbl(this->table);
+    auto res(tbl.recs.emplace(tbl.key(this->rec), this->rec));
+    if (res.second) { index(tbl, res.first->second); }
   }
 
   template <typename RecT, typename...KeyT>
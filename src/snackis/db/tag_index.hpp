@@ -0,0 +1,136 @@
+#ifndef SNACKIS_DB_TAG_INDEX_HPP
+#define SNACKIS_DB_TAG_INDEX_HPP
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "snackis/core/str.hpp"
+#include "snackis/db/col.hpp"
+#include "snackis/db/index.hpp"
+
+namespace snackis {
+namespace db {
+  // Maps tags to records carrying them; lists are appended to and sorted
+  // on first use, which keeps reindexing linear
+  template <typename RecT>
+  struct TagIndex: Index<RecT> {
+    using Recs = std::vector<const Rec<RecT> *>;
+
+    struct Tag {
+      Recs recs;
+      bool sorted;
+
+      Tag();
+    };
+
+    const Col<RecT, std::set<str>> &col;
+    std::map<str, Tag> tags;
+
+    TagIndex(const Col<RecT, std::set<str>> &col);
+    void insert(const Rec<RecT> &rec) override;
+    void erase(const Rec<RecT> &rec) override;
+    void clear() override;
+  };
+
+  template <typename RecT>
+  TagIndex<RecT>::Tag::Tag():
+    sorted(true)
+  { }
+
+  template <typename RecT>
+  TagIndex<RecT>::TagIndex(const Col<RecT, std::set<str>> &col):
+    col(col)
+  { }
+
+  template <typename RecT>
+  const typename TagIndex<RecT>::Recs &get_recs(typename TagIndex<RecT>::Tag &tag) {
+    if (!tag.sorted) {
+      std::sort(tag.recs.begin(), tag.recs.end());
+      tag.sorted = true;
+    }
+
+    return tag.recs;
+  }
+
+  template <typename RecT>
+  void TagIndex<RecT>::insert(const Rec<RecT> &rec) {
+    for (auto &t: get_val(rec, col)) {
+      auto &tag(tags[t]);
+      if (!tag.recs.empty() && &rec < tag.recs.back()) { tag.sorted = false; }
+      tag.recs.push_back(&rec);
+    }
+  }
+
+  template <typename RecT>
+  void TagIndex<RecT>::erase(const Rec<RecT> &rec) {
+    for (auto &t: get_val(rec, col)) {
+      auto fnd(tags.find(t));
+      if (fnd == tags.end()) { continue; }
+      auto &tag(fnd->second);
+      get_recs<RecT>(tag);
+      auto i(std::lower_bound(tag.recs.begin(), tag.recs.end(), &rec));
+      if (i != tag.recs.end() && *i == &rec) { tag.recs.erase(i); }
+      if (tag.recs.empty()) { tags.erase(fnd); }
+    }
+  }
+
+  template <typename RecT>
+  void TagIndex<RecT>::clear() {
+    tags.clear();
+  }
+
+  // Searches large for each item in small with exponentially growing
+  // steps, which is cheap when small is much smaller than large
+  template <typename T>
+  void gallop_intersect(const std::vector<T> &small,
+			const std::vector<T> &large,
+			std::vector<T> &out) {
+    auto i(large.begin()), end(large.end());
+
+    for (auto &v: small) {
+      auto hi(i);
+      size_t step(1);
+
+      while (hi != end && *hi < v) {
+	i = hi+1;
+	hi = (size_t(end-i) > step) ? i+step : end;
+	step *= 2;
+      }
+
+      i = std::lower_bound(i, hi, v);
+      if (i == end) { break; }
+      if (*i == v) { out.push_back(v); i++; }
+    }
+  }
+
+  // Returns records carrying all tags, ordered by address
+  template <typename RecT>
+  std::vector<const Rec<RecT> *> find(TagIndex<RecT> &idx,
+				      const std::set<str> &tags) {
+    std::vector<const typename TagIndex<RecT>::Recs *> lists;
+
+    for (auto &t: tags) {
+      auto fnd(idx.tags.find(t));
+      if (fnd == idx.tags.end()) { return {}; }
+      lists.push_back(&get_recs<RecT>(fnd->second));
+    }
+
+    if (lists.empty()) { return {}; }
+
+    std::sort(lists.begin(), lists.end(),
+	      [](auto x, auto y) { return x->size() < y->size(); });
+    std::vector<const Rec<RecT> *> out(*lists.front());
+
+    for (auto i(std::next(lists.begin())); i != lists.end() && !out.empty(); i++) {
+      std::vector<const Rec<RecT> *> prev;
+      prev.swap(out);
+      gallop_intersect(prev, **i, out);
+    }
+
+    return out;
+  }
+}}
+
+#endif
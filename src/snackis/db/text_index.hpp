@@ -0,0 +1,107 @@
+#ifndef SNACKIS_DB_TEXT_INDEX_HPP
+#define SNACKIS_DB_TEXT_INDEX_HPP
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "snackis/core/str.hpp"
+#include "snackis/db/col.hpp"
+#include "snackis/db/index.hpp"
+
+namespace snackis {
+namespace db {
+  // Maps terms in text columns to records containing them
+  template <typename RecT>
+  struct TextIndex: Index<RecT> {
+    using Cols = std::vector<const Col<RecT, str> *>;
+    using Recs = std::set<const Rec<RecT> *>;
+
+    const Cols cols;
+    std::map<str, Recs> terms;
+
+    TextIndex(std::initializer_list<const Col<RecT, str> *> cols);
+    void insert(const Rec<RecT> &rec) override;
+    void erase(const Rec<RecT> &rec) override;
+    void clear() override;
+  };
+
+  template <typename RecT>
+  TextIndex<RecT>::TextIndex(std::initializer_list<const Col<RecT, str> *> cols):
+    cols(cols)
+  { }
+
+  template <typename RecT>
+  std::set<str> rec_terms(const TextIndex<RecT> &idx, const Rec<RecT> &rec) {
+    std::set<str> out;
+
+    for (auto c: idx.cols) {
+      auto v(find(rec, *c));
+      if (!v) { continue; }
+      auto ts(term_set(std::get<str>(*v)));
+      out.insert(ts.begin(), ts.end());
+    }
+
+    return out;
+  }
+
+  template <typename RecT>
+  void TextIndex<RecT>::insert(const Rec<RecT> &rec) {
+    for (auto &t: rec_terms(*this, rec)) { terms[t].insert(&rec); }
+  }
+
+  template <typename RecT>
+  void TextIndex<RecT>::erase(const Rec<RecT> &rec) {
+    for (auto &t: rec_terms(*this, rec)) {
+      auto fnd(terms.find(t));
+      if (fnd == terms.end()) { continue; }
+      fnd->second.erase(&rec);
+      if (fnd->second.empty()) { terms.erase(fnd); }
+    }
+  }
+
+  template <typename RecT>
+  void TextIndex<RecT>::clear() {
+    terms.clear();
+  }
+
+  // Returns records with terms starting with every term in text
+  template <typename RecT>
+  std::vector<const Rec<RecT> *> match(const TextIndex<RecT> &idx,
+				       const str &text) {
+    std::vector<const Rec<RecT> *> out;
+    bool first(true);
+
+    for (auto &t: term_set(text)) {
+      std::vector<const Rec<RecT> *> found;
+
+      for (auto i(idx.terms.lower_bound(t));
+	   i != idx.terms.end() && i->first.compare(0, t.size(), t) == 0;
+	   i++) {
+	found.insert(found.end(), i->second.begin(), i->second.end());
+      }
+
+      std::sort(found.begin(), found.end());
+      found.erase(std::unique(found.begin(), found.end()), found.end());
+
+      if (first) {
+	out.swap(found);
+	first = false;
+      } else {
+	std::vector<const Rec<RecT> *> prev;
+	prev.swap(out);
+	std::set_intersection(prev.begin(), prev.end(),
+			      found.begin(), found.end(),
+			      std::back_inserter(out));
+      }
+
+      if (out.empty()) { break; }
+    }
+
+    return out;
+  }
+}}
+
+#endif
@@ -12,36 +12,31 @@ namespace db {
   }
 
   Trans::~Trans() {
-    if (!changes.empty()) { rollback(*this); }
+    if (changes) { rollback(*this); }
     ctx.trans = super;
   }
   
-  void log_change(Trans &trans, Change *change) {
-    trans.changes.push_back(std::shared_ptr<Change>(change));
-  }
-
-  static void clear(Trans &trans) {
-    trans.changes.clear();
-  }
-  
   void commit(Trans &trans, const opt<str> &lbl) {
-    if (trans.changes.empty()) { return; }
+    if (!trans.changes) { return; }
 
     Ctx &ctx(trans.ctx);
     Msg msg(MSG_COMMIT);
     set(msg, Msg::SENDER, &ctx);
-    set(msg, Msg::CHANGES, trans.changes);
-    put(ctx.proc.inbox, msg);
+    set(msg, Msg::CHANGES, Changes{trans.changes});
+    set(msg, Msg::TIME,
+	int64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+		  Clock::now().time_since_epoch()).count()));
+    put(ctx.proc.write_loop.inbox, std::move(msg));
+    push(ctx.proc.feed, ctx, trans.changes);
     
-    if (lbl) {
-      ctx.undo_stack.emplace_back(ctx, *lbl, trans.changes);
-    } else {
-      clear(trans);
-    }
+    if (lbl) { ctx.undo_stack.emplace_back(ctx, *lbl, trans.changes); }
+    trans.changes.reset();
   }
   
   void rollback(Trans &trans) {
-    for (auto &c: trans.changes) { c->rollback(); }
-    clear(trans);
+    if (!trans.changes) { return; }
+    auto &cs(trans.changes->changes);
+    for (auto c(cs.rbegin()); c != cs.rend(); c++) { (*c)->rollback(); }
+    trans.changes.reset();
   }
 }}
@@ -10,12 +10,17 @@ namespace db {
   struct Trans {
     Ctx &ctx;
     Trans *super;
-    Changes changes;
+    std::shared_ptr<ChangeLog> changes;
     Trans(Ctx &ctx);
     ~Trans();
   };
 
-  void log_change(Trans &trans, Change *change);
+  template <typename ChangeT, typename...Args>
+  void log_change(Trans &trans, Args &&...args) {
+    if (!trans.changes) { trans.changes = std::make_shared<ChangeLog>(); }
+    log_change<ChangeT>(*trans.changes, std::forward<Args>(args)...);
+  }
+
   void commit(Trans &trans, const opt<str> &lbl);
   void rollback(Trans &trans);
 }}
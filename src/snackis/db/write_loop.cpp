@@ -1,3 +1,10 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+
+#include "snackis/core/stream.hpp"
+#include "snackis/core/time.hpp"
+#include "snackis/core/utils.hpp"
 #include "snackis/db/basic_table.hpp"
 #include "snackis/db/ctx.hpp"
 #include "snackis/db/error.hpp"
@@ -6,6 +13,37 @@
 
 namespace snackis {
 namespace db {
+  LogFile::LogFile(const BasicTable &tbl):
+    fd(-1),
+    size(max(path_size(tbl.path), 0)),
+    dead(tbl.dead_bytes),
+    snap(max(read_snapshot_size(tbl), 0))
+  { }
+
+  LogFile::~LogFile() { close(*this); }
+
+  WriteStats::WriteStats():
+    commits(0), groups(0), syncs(0), latency(0)
+  { }
+
+  Compaction::Compaction(BasicTable &tbl, bool snapshot,
+			 int64_t size, int64_t dead):
+    table(tbl),
+    name(tbl.name),
+    path(tbl.path),
+    snap_path(tbl.snap_path),
+    snapshot(snapshot),
+    tmp_path((snapshot ? tbl.snap_path : tbl.path).string() + ".tmp"),
+    size(size),
+    dead(dead),
+    ok(false),
+    table_done(done.get_future().share())
+  { }
+
+  Rewrite::Rewrite():
+    pending(0), reclaimed(0), ok(true)
+  { }
+
   WriteLoop::WriteLoop(Proc &p, size_t max_buf):
     Loop(p, max_buf)
   {
@@ -14,65 +52,459 @@ namespace db {
 
   WriteLoop::~WriteLoop() {
     stop(*this);
+
+    for (auto &c: compactions) {
+      c.second->thread.join();
+      remove_path(c.second->tmp_path);
+    }
+
+    for (auto &f: files) { flush(f.second); }
+  }
+
+  bool flush(LogFile &f) {
+    size_t offs(0);
+    
+    while (offs < f.buf.size()) {
+      auto res(::write(f.fd, f.buf.data()+offs, f.buf.size()-offs));
+      
+      if (res == -1) {
+	ERROR(Db, "Failed writing log");
+	return false;
+      }
+      
+      offs += res;
+    }
+
+    f.buf.clear();
+    return true;
+  }
+
+  bool sync(LogFile &f) {
+    if (fdatasync(f.fd) == -1) {
+      ERROR(Db, "Failed syncing log");
+      return false;
+    }
+
+    return true;
+  }
+
+  void close(LogFile &f) {
+    if (f.fd == -1) { return; }
+    flush(f);
+    ::close(f.fd);
+    f.fd = -1;
+  }
+
+  static LogFile &get_log(WriteLoop &lp, const BasicTable &tbl) {
+    auto fnd(lp.files.find(tbl.path));
+    if (fnd != lp.files.end()) { return fnd->second; }
+
+    return lp.files.emplace(std::piecewise_construct,
+			    std::forward_as_tuple(tbl.path),
+			    std::forward_as_tuple(tbl)).first->second;
+  }
+
+  static LogFile *get_file(WriteLoop &lp, const Change &c) {
+    auto &tbl(c.base_table());
+    auto &f(get_log(lp, tbl));
+
+    if (f.fd == -1) {
+      f.fd = ::open(tbl.path.string().c_str(),
+		    O_WRONLY | O_CREAT | O_APPEND,
+		    0666);
+
+      if (f.fd == -1) {
+	ERROR(Db, fmt("Failed opening file: %0", tbl.path.string()));
+	return nullptr;
+      }
+
+      OutStream buf;
+      c.write_schema(buf);
+      f.buf += buf.str();
+      f.size += buf.tellp();
+    }
+
+    return &f;
+  }
+
+  // Encrypts pending page records as one block
+  static void seal(LogFile &f, const BasicTable &tbl) {
+    if (f.page.empty()) { return; }
+    OutStream buf;
+    write_page(*tbl.ctx.secret, f.page, buf);
+    f.buf += buf.str();
+    f.size += buf.tellp();
+    f.page.clear();
+  }
+
+  static void rewritten(WriteLoop &lp, Ctx *ctx, int64_t reclaimed, bool ok) {
+    auto &rw(lp.rewrites[ctx]);
+    rw.reclaimed += reclaimed;
+    rw.ok = rw.ok && ok;
+    if (rw.pending && --rw.pending) { return; }
+    
+    Msg msg(rw.ok ? MSG_OK : MSG_ERROR);
+    set(msg, Msg::RECLAIMED, rw.reclaimed);
+    put(ctx->inbox, std::move(msg));
+    lp.rewrites.erase(ctx);
   }
   
-  static std::ofstream &get_file(WriteLoop &lp, const Path &p) {
-    auto fnd(lp.files.find(p));
-
-    if (fnd == lp.files.end()) {
-      auto &f(lp.files.emplace(p, 
-			       std::ofstream(p.string(),
-					     std::ios::out | 
-					     std::ios::binary | 
-					     std::ios::app)).first->second);
-      if (f.fail()) {
-	lp.files.erase(p);
-	ERROR(Db, fmt("Failed opening file: %0", p.string()));
+  static void snapshotted(WriteLoop &lp, Compaction &c, LogFile &f) {
+    if (c.ok && rename_path(c.tmp_path, c.snap_path)) {
+      f.snap = c.size;
+      log(lp.proc, "Wrote snapshot of %0 (%1 bytes)", c.name, c.size);
+    } else {
+      remove_path(c.tmp_path);
+      log(lp.proc, "Failed writing snapshot of %0", c.name);
+    }
+  }
+  
+  static int64_t replace_log(WriteLoop &lp, Compaction &c, LogFile &f) {
+    const Path &p(c.path);
+    int64_t reclaimed(0);
+    
+    if (c.ok) {
+      TRY(try_close);
+      close(f);
+      c.ok = try_close.errors.empty();
+    }
+    
+    if (c.ok) {
+      // Append tail written while compacting
+      if (f.size > c.size) {
+	std::ifstream in(p.string(), std::ios::in | std::ios::binary);
+	std::ofstream out(c.tmp_path.string(),
+			  std::ios::out | std::ios::binary | std::ios::app);
+	in.seekg(c.size);
+	out << in.rdbuf();
+	c.ok = !in.fail() && !out.fail();
       }
 
-      return f;
+      c.ok = c.ok && sync_path(c.tmp_path);
+      const int64_t size(path_size(c.tmp_path));
+
+      // Snapshot offsets refer to the old log
+      if (c.ok && size != -1) {
+	remove_path(c.snap_path);
+	f.snap = 0;
+      }
+      
+      if (c.ok && size != -1 && rename_path(c.tmp_path, p)) {
+	reclaimed = f.size - size;
+	f.size = size;
+	f.dead = max(f.dead - c.dead, 0);
+	log(lp.proc, "Compacted %0, reclaimed %1 bytes",
+	    p.filename().string(), reclaimed);
+      } else {
+	c.ok = false;
+      }
     }
 
-    return fnd->second;
+    if (!c.ok) {
+      remove_path(c.tmp_path);
+      log(lp.proc, "Failed compacting %0", p.filename().string());
+    }
+
+    return reclaimed;
   }
 
-  void WriteLoop::on_msg(const Msg &msg) {
-    auto ctx(get(msg, Msg::SENDER));
+  static BasicTable *find_table(Ctx &ctx, const Path &p) {
+    for (auto &t: ctx.tables) {
+      if (t.second->path == p) { return t.second; }
+    }
 
-    switch (msg.type) {
-    case MSG_COMMIT: { 
-      std::set<std::ofstream *> dirty;
+    return nullptr;
+  }
+  
+  static void compacted(WriteLoop &lp, const Path &p) {
+    std::unique_ptr<Compaction> c;
+
+    {
+      std::unique_lock<std::mutex> lock(lp.compact_mutex);
+      auto fnd(lp.compactions.find(p));
+      CHECK(fnd != lp.compactions.end(), _);
+      c.swap(fnd->second);
+      lp.compactions.erase(fnd);
+    }
+
+    c->thread.join();
+    auto &f(lp.files.at(p));
+    int64_t reclaimed(0);
+
+    if (c->snapshot) {
+      snapshotted(lp, *c, f);
+    } else {
+      reclaimed = replace_log(lp, *c, f);
+    }
+
+    for (auto ctx: c->waiting) { rewritten(lp, ctx, reclaimed, c->ok); }
 
-      for (auto &c: get(msg, Msg::CHANGES)) {
-	auto &f(get_file(*this, c->table_path()));
+    // Rewrites requested while compacting need another pass to cover the tail
+    for (auto &q: c->queued) {
+      auto tbl(find_table(*q.first, q.second));
+      if (!tbl || !compact(lp, *tbl, q.first)) { rewritten(lp, q.first, 0, true); }
+    }
+
+    c->done.set_value();
+  }
+
+  static void start(WriteLoop &lp, Compaction *c) {
+    lp.compactions.emplace(c->path, std::unique_ptr<Compaction>(c));
 
-	if (!f.fail()) {
-	  c->write(f);
-	  dirty.insert(&f);
+    c->thread = std::thread([&lp, c]() {
+	TRY(try_compact);
+	const Path p(c->path);
+	std::ofstream out(c->tmp_path.string(),
+			  std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (c->snapshot) {
+	  write_snapshot_header(c->size, 0, out);
+	  const int64_t dead(c->table.compact(c->size, out));
+	  out.seekp(0);
+	  write_snapshot_header(c->size, dead, out);
+	} else {
+	  c->table.compact(c->size, out);
+	}
+	
+	out.close();
+	c->ok = try_compact.errors.empty() && !out.fail() &&
+	  (!c->snapshot || sync_path(c->tmp_path));
+
+	for (auto e: try_compact.errors) {
+	  log(lp.proc, "%0", e->what);
+	  delete e;
 	}
+
+	try_compact.errors.clear();
+	Msg msg(MSG_COMPACTED);
+	set(msg, Msg::PATH, p);
+	put(lp.inbox, std::move(msg));
+      });
+  }
+  
+  bool compact(WriteLoop &lp, BasicTable &tbl, Ctx *waiting) {
+    std::unique_lock<std::mutex> lock(lp.compact_mutex);
+    auto fnd(lp.compactions.find(tbl.path));
+
+    if (!path_exists(tbl.path)) { return false; }
+    auto &f(get_log(lp, tbl));
+
+    if (fnd != lp.compactions.end()) {
+      auto &c(*fnd->second);
+      
+      if (waiting) {
+	if (!c.snapshot && c.size == f.size) {
+	  c.waiting.insert(waiting);
+	} else {
+	  c.queued.emplace(waiting, tbl.path);
+	}
+      }
+      
+      return true;
+    }
+
+    if (f.fd != -1 && !flush(f)) { return false; }
+
+    auto c(new Compaction(tbl, false, f.size, f.dead));
+    if (waiting) { c->waiting.insert(waiting); }
+
+    log(lp.proc, "Compacting %0 (%1 of %2 bytes dead)",
+	tbl.path.filename().string(), f.dead, f.size);
+    start(lp, c);
+    return true;
+  }
+
+  bool snapshot(WriteLoop &lp, BasicTable &tbl) {
+    std::unique_lock<std::mutex> lock(lp.compact_mutex);
+    if (lp.compactions.find(tbl.path) != lp.compactions.end()) { return false; }
+    auto &f(get_log(lp, tbl));
+    if (f.fd == -1) { return false; }
+    const int64_t size(f.size);
+    
+    // Restart the dictionary to make the tail readable on its own
+    OutStream buf;
+    tbl.write_schema(buf);
+    f.buf += buf.str();
+    f.size += buf.tellp();
+    if (!flush(f)) { return false; }
+    
+    start(lp, new Compaction(tbl, true, size, 0));
+    return true;
+  }
+
+  void wait_compact(WriteLoop &lp, const BasicTable &tbl) {
+    // Handling MSG_COMPACTED may start another pass over the same table
+    for (;;) {
+      std::shared_future<void> done;
+
+      {
+	std::unique_lock<std::mutex> lock(lp.compact_mutex);
+	auto fnd(lp.compactions.find(tbl.path));
+	if (fnd == lp.compactions.end() || &fnd->second->table != &tbl) { return; }
+	done = fnd->second->table_done;
+      }
+
+      done.wait();
+    }
+  }
+
+  static void add_latency(WriteLoop &lp, int64_t time) {
+    lp.stats.latency +=
+      std::chrono::duration_cast<std::chrono::microseconds>(
+	Clock::now().time_since_epoch()).count() - time;
+  }
+  
+  static LogFile *write(WriteLoop &lp,
+			const Change &c,
+			std::map<LogFile *, BasicTable *> &dirty,
+			OutStream &buf) {
+    auto f(get_file(lp, c));
+    if (!f) { return nullptr; }
+    auto &tbl(c.base_table());
+    const size_t page_size(lp.proc.page_size);
+    const bool paged(tbl.ctx.secret && page_size);
+    buf.str("");
+    c.write(buf, paged ? nullopt : tbl.ctx.secret);
+    const int64_t size(buf.tellp());
+
+    if (paged) {
+      f->page += buf.str();
+      if (f->page.size() >= page_size) { seal(*f, tbl); }
+    } else {
+      f->buf += buf.str();
+      f->size += size;
+    }
+    
+    f->dead += c.dead_bytes(size);
+    dirty.emplace(f, &tbl);
+    return f;
+  }
+  
+  static void write(WriteLoop &lp,
+		    const Msg &msg,
+		    std::map<LogFile *, BasicTable *> &dirty,
+		    std::vector<int64_t> &times) {
+    const bool sync_commit(lp.proc.durability == DURABLE_COMMIT);
+    std::map<LogFile *, BasicTable *> synced;
+    OutStream buf;
+
+    for (auto &l: get(msg, Msg::CHANGES)) {
+      for (auto c: l->changes) {
+	auto f(write(lp, *c, dirty, buf));
+	if (f && sync_commit) { synced.emplace(f, &c->base_table()); }
+      }
+    }
+
+    for (auto &s: synced) {
+      auto &f(*s.first);
+      seal(f, *s.second);
+      if (flush(f) && sync(f)) { lp.stats.syncs++; }
+    }
+
+    lp.stats.commits++;
+    auto t(find(msg, Msg::TIME));
+
+    if (t) {
+      if (sync_commit) {
+	add_latency(lp, *t);
+      } else {
+	times.push_back(*t);
+      }
+    }
+  }
+  
+  static size_t pending(const std::map<LogFile *, BasicTable *> &dirty) {
+    size_t size(0);
+    for (auto &d: dirty) { size += d.first->buf.size(); }
+    return size;
+  }
+  
+  static void end_group(WriteLoop &lp,
+			const std::map<LogFile *, BasicTable *> &dirty,
+			const std::vector<int64_t> &times) {
+    const auto durability(lp.proc.durability.load());
+    
+    for (auto &d: dirty) {
+      auto &f(*d.first);
+      seal(f, *d.second);
+      
+      if ((durability != DURABLE_NONE || f.buf.size() >= lp.proc.group_size) &&
+	  flush(f) &&
+	  durability == DURABLE_GROUP &&
+	  sync(f)) {
+	lp.stats.syncs++;
+      }
+
+      if (f.size >= lp.proc.compact_size &&
+	  f.dead >= f.size * lp.proc.compact_ratio) {
+	compact(lp, *d.second);
+      } else if (f.size - f.snap >= lp.proc.snapshot_size) {
+	snapshot(lp, *d.second);
+      }
+    }
+
+    for (auto t: times) { add_latency(lp, t); }
+    lp.stats.groups++;
+  }
+  
+  static void commit(WriteLoop &lp, const Msg &msg) {
+    std::map<LogFile *, BasicTable *> dirty;
+    std::vector<int64_t> times;
+    write(lp, msg, dirty, times);
+
+    // Pick up commits queued within group_window until group_size is reached
+    auto deadline(std::chrono::steady_clock::now() +
+		  std::chrono::microseconds(lp.proc.group_window));
+    
+    while (pending(dirty) < lp.proc.group_size) {
+      auto next(get(lp, deadline));
+      if (!next) { break; }
+      
+      if (next->type != MSG_COMMIT) {
+	end_group(lp, dirty, times);
+	lp.on_msg(*next);
+	return;
+      }
+      
+      write(lp, *next, dirty, times);
+    }
+
+    end_group(lp, dirty, times);
+  }
+
+  void WriteLoop::on_msg(Msg &msg) {
+    switch (msg.type) {
+    case MSG_COMMIT:
+      commit(*this, msg);
+      break;
+    case MSG_SYNC: {
+      auto ctx(get(msg, Msg::SENDER));
+      bool ok(true);
+      
+      for (auto &f: files) {
+	if (f.second.fd != -1) { ok = flush(f.second) && sync(f.second) && ok; }
       }
 
-      for (auto f: dirty) { f->flush(); }
+      put(ctx->inbox, Msg(ok ? MSG_OK : MSG_ERROR));
       break;
     }
+    case MSG_WAIT:
+      put(get(msg, Msg::SENDER)->inbox, Msg(MSG_OK));
+      break;
     case MSG_REWRITE: {
-      int64_t reclaimed(0); 
-      
+      auto ctx(get(msg, Msg::SENDER));
+      auto &rw(rewrites[ctx]);
+
       for (auto t: ctx->tables) {
-	auto &f(get_file(*this, t.second->path));
-	auto old_size(f.tellp());
-	f.close();
-	f.open(t.second->path.string(), 
-	       std::ios::out | std::ios::binary | std::ios::trunc);
-	t.second->dump(f);
-	reclaimed += old_size-f.tellp();
+	if (compact(*this, *t.second, ctx)) { rw.pending++; }
       }
 
-      Msg msg(MSG_OK);
-      set(msg, Msg::RECLAIMED, reclaimed);
-      put(ctx->inbox, msg);
+      if (!rw.pending) { rewritten(*this, ctx, 0, true); }
       break;
     }
+    case MSG_COMPACTED:
+      compacted(*this, get(msg, Msg::PATH));
+      break;
     default:
       log(proc, "Unsupported message type: %0", msg.type);
     }
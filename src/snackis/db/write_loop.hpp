@@ -1,23 +1,84 @@
 #ifndef SNACKIS_DB_WRITE_LOOP_HPP
 #define SNACKIS_DB_WRITE_LOOP_HPP
 
-#include <fstream>
+#include <future>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 
 #include "snackis/core/path.hpp"
 #include "snackis/db/loop.hpp"
 
 namespace snackis {
 namespace db {
+  struct BasicTable;
   struct Proc;
+
+  // Pending bytes are buffered until the end of each commit group,
+  // page holds records waiting to be encrypted and snap is the log size
+  // covered by the current snapshot
+  struct LogFile {
+    int fd;
+    str buf, page;
+    int64_t size, dead, snap;
+
+    LogFile(const BasicTable &tbl);
+    LogFile(const LogFile &) = delete;
+    ~LogFile();
+    LogFile &operator =(const LogFile &) = delete;
+  };
+
+  struct WriteStats {
+    int64_t commits, groups, syncs, latency;
+    WriteStats();
+  };
+
+  // Snapshots are written like compactions but leave the log alone,
+  // done is set once MSG_COMPACTED has been handled
+  struct Compaction {
+    BasicTable &table;
+    const str name;
+    const Path path, snap_path;
+    const bool snapshot;
+    const Path tmp_path;
+    const int64_t size, dead;
+    std::set<Ctx *> waiting;
+    std::map<Ctx *, Path> queued;
+    bool ok;
+    std::promise<void> done;
+    std::shared_future<void> table_done;
+    std::thread thread;
+    
+    Compaction(BasicTable &tbl, bool snapshot, int64_t size, int64_t dead);
+  };
+
+  struct Rewrite {
+    size_t pending;
+    int64_t reclaimed;
+    bool ok;
+
+    Rewrite();
+  };
   
   struct WriteLoop: Loop {
-    std::map<Path, std::ofstream> files;
+    std::map<Path, LogFile> files;
+    std::map<Path, std::unique_ptr<Compaction>> compactions;
+    std::mutex compact_mutex;
+    std::map<Ctx *, Rewrite> rewrites;
+    WriteStats stats;
     
     WriteLoop(Proc &p, size_t max_buf);
     ~WriteLoop();
-    void on_msg(const Msg &msg) override;
+    void on_msg(Msg &msg) override;
   };
+
+  bool flush(LogFile &f);
+  bool sync(LogFile &f);
+  void close(LogFile &f);
+  bool compact(WriteLoop &lp, BasicTable &tbl, Ctx *waiting=nullptr);
+  bool snapshot(WriteLoop &lp, BasicTable &tbl);
+  void wait_compact(WriteLoop &lp, const BasicTable &tbl);
 }}
 
 #endif
@@ -69,22 +69,12 @@ namespace snackis {
 						const Time &end,
 						size_t max) {
     Ctx &ctx(fd.ctx);
-    auto &tbl(ctx.db.feed_posts);
     std::vector<const db::Rec<Post> *> out;
-    if (tbl.recs.empty()) { return out; }
-    
-    auto fnd(tbl.recs.lower_bound(tbl.key(fd.id, end, null_uid)));
-    if (fnd == tbl.recs.begin()) { return out; }
-    fnd--;
-    
-    while (out.size() < max) {
-      if (*db::get(fnd->second, post_feed_id) != fd.id) { break; }
-      const db::Rec<Post> &rec(db::get(ctx.db.posts, fnd->second));
-      out.push_back(&rec);
-      if (fnd == tbl.recs.begin()) { break; }
-      fnd--;
-    }
-
+    auto &idx(ctx.db.feed_posts);
+    auto cur(db::scan(idx, db::SCAN_REV));
+    db::seek(cur, idx.key(fd.id, end, null_uid), 1);
+    cur.limit = max;
+    while (auto rec = db::next_rec(cur)) { out.push_back(rec); }
     return out;
   }
 }
@@ -81,39 +81,20 @@ namespace gui {
     str text_sel(trim(gtk_entry_get_text(GTK_ENTRY(text_fld))));
     auto &peer_sel(peer_fld.selected);
     
-    for (auto key = ctx.db.feeds_sort.recs.rbegin();
-	 key != ctx.db.feeds_sort.recs.rend();
-	 key++) {
-      auto &rec(db::get(ctx.db.feeds, key->second));
+    db::Query<Feed> q;
+    q.limit = SEARCH_MAX;
+    db::from(q, db::scan(ctx.db.feeds_sort, db::SCAN_REV), db::SOURCE_ALL);
+    if (id_sel.empty()) { db::eq(q, feed_visible, true); }
+    filter_id(q, ctx.db.feeds_ids, ctx.db.feeds_sort, db::SCAN_REV, id_sel);
+    db::eq(q, feed_active, active_sel);
+    db::tagged(q, ctx.db.feeds_tags, ctx.db.feeds_sort, tags_sel, db::SCAN_REV);
+    db::has_all(q, feed_tags, tags_sel);
+    db::contains(q, {&feed_name, &feed_info}, text_sel);
+    if (peer_sel) { filter_peer(q, feed_owner_id, feed_peer_ids, peer_sel->id); }
+    
+    for (auto r: db::run(q)) {
+      auto &rec(*r);
       Feed feed(ctx, rec);
-
-      if (id_sel.empty() && !feed.visible) { continue; }
-
-      if (!id_sel.empty() && find_ci(id_str(feed), id_sel) == str::npos) {
-	continue;
-      }
-
-      if (feed.active != active_sel) { continue; }
-
-      if (!tags_sel.empty()) {
-	std::vector<str> diff;
-	std::set_difference(tags_sel.begin(), tags_sel.end(),
-			    feed.tags.begin(), feed.tags.end(),
-			    std::back_inserter(diff));
-	if (!diff.empty()) { continue; }
-      }
-      
-      if (!text_sel.empty() &&
-	  find_ci(feed.name, text_sel) == str::npos &&
-	  find_ci(feed.info, text_sel) == str::npos) {
-	continue;
-      }
-
-      if (peer_sel) {
-	if (feed.owner_id != peer_sel->id &&
-	    feed.peer_ids.find(peer_sel->id) == feed.peer_ids.end()) { continue; }
-      }      
-      
       Peer own(get_peer_id(ctx, feed.owner_id));
 
       GtkTreeIter iter;
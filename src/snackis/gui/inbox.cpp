@@ -118,8 +118,10 @@ namespace gui {
     gtk_list_store_clear(store);
     size_t cnt(0);
     
-    for(const auto &key: ctx.db.inbox_sort.recs) {
-      auto &rec(db::get(ctx.db.inbox, key.second));
+    auto cur(db::scan(ctx.db.inbox_sort));
+
+    while (auto r = db::next_rec(cur)) {
+      auto &rec(*r);
       Msg msg(ctx, rec);
 
       GtkTreeIter iter;
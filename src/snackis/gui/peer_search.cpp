@@ -62,31 +62,20 @@ namespace gui {
     std::set<str> tags_sel(word_set(tags_str));
     str text_sel(trim(gtk_entry_get_text(GTK_ENTRY(text_fld))));
     
-    for (const auto &key: ctx.db.peers_sort.recs) {
-      auto &rec(db::get(ctx.db.peers, key.second));
+    db::Query<Peer> q;
+    q.limit = SEARCH_MAX;
+    db::from(q, db::scan(ctx.db.peers_sort), db::SOURCE_ALL);
+    db::match(q, ctx.db.peers_text, ctx.db.peers_sort, text_sel, db::SCAN_FWD);
+    filter_id(q, ctx.db.peers_ids, ctx.db.peers_sort, db::SCAN_FWD, id_sel);
+    db::eq(q, peer_active, active_sel);
+    db::tagged(q, ctx.db.peers_tags, ctx.db.peers_sort, tags_sel, db::SCAN_FWD);
+    db::has_all(q, peer_tags, tags_sel);
+    db::contains(q, {&peer_name, &peer_email, &peer_info}, text_sel);
+    
+    for (auto r: db::run(q)) {
+      auto &rec(*r);
       Peer peer(ctx, rec);
 
-      if (!id_sel.empty() && find_ci(id_str(peer), id_sel) == str::npos) {
-	continue;
-      }
-
-      if (peer.active != active_sel) { continue; }
-
-      if (!tags_sel.empty()) {
-	std::vector<str> diff;
-	std::set_difference(tags_sel.begin(), tags_sel.end(),
-			    peer.tags.begin(), peer.tags.end(),
-			    std::back_inserter(diff));
-	if (!diff.empty()) { continue; }
-      }
-      
-      if (!text_sel.empty() &&
-	  find_ci(peer.name, text_sel) == str::npos &&
-	  find_ci(peer.email, text_sel) == str::npos &&
-	  find_ci(peer.info, text_sel) == str::npos) {
-	continue;
-      }
-
       GtkTreeIter iter;
       gtk_list_store_append(store, &iter);
       gtk_list_store_set(store, &iter,
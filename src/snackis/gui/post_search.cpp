@@ -107,47 +107,56 @@ namespace gui {
     }
 
     auto me(whoamid(ctx));
+    const Time end(max_time_sel
+		   ? *max_time_sel+std::chrono::minutes(1)
+		   : max_time);
+    db::Query<Post> q;
+    q.limit = SEARCH_MAX;
+    db::from(q, db::scan(ctx.db.posts_sort, db::SCAN_REV), db::SOURCE_ALL);
     
-    for (auto key = ctx.db.posts_sort.recs.rbegin();
-	 key != ctx.db.posts_sort.recs.rend();
-	 key++) {
-      auto &rec(db::get(ctx.db.posts, key->second));
-      Post post(ctx, rec);
-      Feed feed(get_feed_id(ctx, post.feed_id));
-
-      if (!id_sel.empty() && find_ci(id_str(post), id_sel) == str::npos) {
-	continue;
-      }
+    if (min_time_sel || max_time_sel) {
+      auto &idx(ctx.db.posts_sort);
+      auto cur(db::scan(idx, db::SCAN_REV));
+      db::seek(cur, idx.key(end, null_uid));
+      if (min_time_sel) { db::bound(cur, idx.key(*min_time_sel, null_uid)); }
+      db::from(q, cur, db::SOURCE_RANGE);
+    }
 
-      if (!tags_sel.empty()) {
-	std::vector<str> diff;
-	std::set_difference(tags_sel.begin(), tags_sel.end(),
-			    post.tags.begin(), post.tags.end(),
-			    std::back_inserter(diff));
-	if (!diff.empty()) { continue; }
-      }
+    if (feed_sel) {
+      auto &idx(ctx.db.feed_posts);
+      auto cur(db::scan(idx, db::SCAN_REV));
+      db::seek(cur, idx.key(feed_sel->id, end, null_uid), 1);
       
-      if (!body_sel.empty() && find_ci(post.body, body_sel) == str::npos) {
-	continue;
-      }
-
-      if (!min_time_str.empty() && post.created_at < *min_time_sel) {
-	continue;
-      }
-
-      if (!max_time_str.empty() && post.created_at > *max_time_sel) {
-	continue;
+      if (min_time_sel) {
+	db::bound(cur, idx.key(feed_sel->id, *min_time_sel, null_uid));
       }
       
-      if (feed_sel && post.feed_id != feed_sel->id) { continue; }
+      db::from(q, cur, db::SOURCE_PREFIX);
+      db::eq(q, post_feed_id, feed_sel->id);
+    }
 
-      if (peer_sel &&
-	  post.owner_id != peer_sel->id &&
-	  (post.owner_id != me ||
-	   post.peer_ids.find(peer_sel->id) == post.peer_ids.end())) {
-	continue;
-      }
+    db::match(q, ctx.db.posts_text, ctx.db.posts_sort, body_sel, db::SCAN_REV);
+    db::range(q, post_created_at, min_time_sel, max_time_sel);
+    db::tagged(q, ctx.db.posts_tags, ctx.db.posts_sort, tags_sel, db::SCAN_REV);
+    db::has_all(q, post_tags, tags_sel);
+    db::contains(q, {&post_body}, body_sel);
+    filter_id(q, ctx.db.posts_ids, ctx.db.posts_sort, db::SCAN_REV, id_sel);
+
+    if (peer_sel) {
+      const UId sel_id(peer_sel->id);
       
+      db::filter(q, [me, sel_id](auto &rec) {
+	  auto own(db::get_val(rec, post_owner_id));
+	  if (own == sel_id) { return true; }
+	  if (own != me) { return false; }
+	  auto ps(db::get_val(rec, post_peer_ids));
+	  return ps.find(sel_id) != ps.end();
+	});
+    }
+    
+    for (auto r: db::run(q)) {
+      auto &rec(*r);
+      Post post(ctx, rec);
       auto pr(get_peer_id(ctx, post.owner_id));
       
       GtkTreeIter iter;
@@ -72,36 +72,19 @@ namespace gui {
     str text_sel(trim(gtk_entry_get_text(GTK_ENTRY(text_fld)))); 
     auto &peer_sel(peer_fld.selected);
     
-    for (const auto &key: ctx.db.projects_sort.recs) {
-      auto &rec(db::get(ctx.db.projects, key.second));
+    db::Query<Project> q;
+    q.limit = SEARCH_MAX;
+    db::from(q, db::scan(ctx.db.projects_sort), db::SOURCE_ALL);
+    filter_id(q, ctx.db.projects_ids, ctx.db.projects_sort, db::SCAN_FWD, id_sel);
+    db::eq(q, project_active, active_sel);
+    db::tagged(q, ctx.db.projects_tags, ctx.db.projects_sort, tags_sel, db::SCAN_FWD);
+    db::has_all(q, project_tags, tags_sel);
+    db::contains(q, {&project_name, &project_info}, text_sel);
+    if (peer_sel) { filter_peer(q, project_owner_id, project_peer_ids, peer_sel->id); }
+    
+    for (auto r: db::run(q)) {
+      auto &rec(*r);
       Project project(ctx, rec);
-
-      if (!id_sel.empty() && find_ci(id_str(project), id_sel) == str::npos) {
-	continue;
-      }
-
-      if (project.active != active_sel) { continue; }
-
-      if (!tags_sel.empty()) {
-	std::vector<str> diff;
-	std::set_difference(tags_sel.begin(), tags_sel.end(),
-			    project.tags.begin(), project.tags.end(),
-			    std::back_inserter(diff));
-	if (!diff.empty()) { continue; }
-      }
-      
-      if (!text_sel.empty() &&
-	  find_ci(project.name, text_sel) == str::npos &&
-	  find_ci(project.info, text_sel) == str::npos) {
-	continue;
-      }
-
-      if (peer_sel &&
-	  project.owner_id != peer_sel->id &&
-	  project.peer_ids.find(peer_sel->id) == project.peer_ids.end()) {
-	continue;
-      }
-      
       Peer own(get_peer_id(ctx, project.owner_id));
 
       GtkTreeIter iter;
@@ -136,7 +136,7 @@ namespace gui {
     init_search<FeedSearch>(rdr, "feed");
 
     add_cmd(rdr, "fetch", {}, [&ctx](auto args) {
-	imap_worker->go.notify_one();
+	net::poke(*imap_worker);
       });
 
     add_cmd(rdr, "inbox", {}, [&ctx](auto args) {
@@ -183,7 +183,7 @@ namespace gui {
 	if (ctx.db.outbox.recs.empty()) {
 	  log(ctx, "Nothing to send");
 	} else {
-	  smtp_worker->go.notify_one();
+	  net::poke(*smtp_worker);
 	}
       });
 
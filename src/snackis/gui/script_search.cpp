@@ -67,32 +67,18 @@ namespace gui {
     str code_sel(trim(gtk_entry_get_text(GTK_ENTRY(code_fld)))); 
     auto &peer_sel(peer_fld.selected);
     
-    for (const auto &key: ctx.db.scripts_sort.recs) {
-      auto &rec(db::get(ctx.db.scripts, key.second));
+    db::Query<Script> q;
+    q.limit = SEARCH_MAX;
+    db::from(q, db::scan(ctx.db.scripts_sort), db::SOURCE_ALL);
+    filter_id(q, ctx.db.scripts_ids, ctx.db.scripts_sort, db::SCAN_FWD, id_sel);
+    db::tagged(q, ctx.db.scripts_tags, ctx.db.scripts_sort, tags_sel, db::SCAN_FWD);
+    db::has_all(q, script_tags, tags_sel);
+    db::contains(q, {&script_code}, code_sel);
+    if (peer_sel) { filter_peer(q, script_owner_id, script_peer_ids, peer_sel->id); }
+    
+    for (auto r: db::run(q)) {
+      auto &rec(*r);
       Script script(ctx, rec);
-
-      if (!id_sel.empty() && find_ci(id_str(script), id_sel) == str::npos) {
-	continue;
-      }
-
-      if (!tags_sel.empty()) {
-	std::vector<str> diff;
-	std::set_difference(tags_sel.begin(), tags_sel.end(),
-			    script.tags.begin(), script.tags.end(),
-			    std::back_inserter(diff));
-	if (!diff.empty()) { continue; }
-      }
-      
-      if (!code_sel.empty() && find_ci(script.code, code_sel) == str::npos) {
-	continue;
-      }
-
-      if (peer_sel &&
-	  script.owner_id != peer_sel->id &&
-	  script.peer_ids.find(peer_sel->id) == script.peer_ids.end()) {
-	continue;
-      }
-      
       Peer own(get_peer_id(ctx, script.owner_id));
 
       GtkTreeIter iter;
@@ -1,13 +1,20 @@
 #ifndef SNACKIS_GUI_SEARCH_VIEW_HPP
 #define SNACKIS_GUI_SEARCH_VIEW_HPP
 
+#include <algorithm>
+
 #include "snackis/core/error.hpp"
 #include "snackis/core/func.hpp"
+#include "snackis/id_rec.hpp"
+#include "snackis/db/id_index.hpp"
+#include "snackis/db/query.hpp"
 #include "snackis/gui/gui.hpp"
 #include "snackis/gui/view.hpp"
 
 namespace snackis {
 namespace gui {
+  const size_t SEARCH_MAX(1000);
+  
   template <typename RecT>
   struct SearchView: View {
     using OnActivate = func<void (const db::Rec<RecT> &)>;
@@ -20,6 +27,49 @@ namespace gui {
     virtual void find()=0;
   };
 
+  // Ids are resolved as prefixes through ids, any part of the short id
+  // matches when no prefix does
+  template <typename RecT, typename...KeyT>
+  void filter_id(db::Query<RecT> &q,
+		 const db::IdIndex<RecT> &ids,
+		 const db::KeyIndex<RecT, KeyT...> &order,
+		 db::ScanDir dir,
+		 const str &sel) {
+    if (sel.empty()) { return; }
+    auto found(db::find_prefix(ids, sel));
+    
+    if (found.empty()) {
+      auto &col(*std::get<0>(ids.key));
+      
+      db::filter(q, [&col, sel](auto &rec) {
+	  auto id(db::peek(rec, col));
+	  return id && find_ci(id_str(*id), sel) != str::npos;
+	});
+      
+      return;
+    }
+
+    db::from(q, order, found, dir, db::SOURCE_MATCH);
+    std::sort(found.begin(), found.end());
+    
+    db::filter(q, [found](auto &rec) {
+	return std::binary_search(found.begin(), found.end(), &rec);
+      });
+  }
+
+  // Matches records owned by or shared with id
+  template <typename RecT>
+  void filter_peer(db::Query<RecT> &q,
+		   const db::Col<RecT, UId> &owner_col,
+		   const db::Col<RecT, std::set<UId>> &peers_col,
+		   const UId &id) {
+    db::filter(q, [&owner_col, &peers_col, id](auto &rec) {
+	if (db::get_val(rec, owner_col) == id) { return true; }
+	auto ps(db::get_val(rec, peers_col));
+	return ps.find(id) != ps.end();
+      });
+  }
+
   template <typename RecT>
   size_t find(SearchView<RecT> &v) {
     TRY(try_find);
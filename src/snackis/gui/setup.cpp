@@ -135,12 +135,12 @@ namespace gui {
 
     copy_flds(v->imap);
     if (*get_val(ctx.settings.imap.poll)) {
-      imap_worker->go.notify_one();
+      net::poke(*imap_worker);
     }
     
     copy_flds(v->smtp);
     if (*get_val(ctx.settings.smtp.poll)) {
-      smtp_worker->go.notify_one();
+      net::poke(*smtp_worker);
     }
 
     if (try_save.errors.empty()) {
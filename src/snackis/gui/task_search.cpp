@@ -86,33 +86,31 @@ namespace gui {
     str text_sel(get_str(GTK_ENTRY(text_fld)));
     auto peer_sel(peer_fld.selected);
     
-    for (const auto &key: ctx.db.tasks_sort.recs) {
-      auto &rec(db::get(ctx.db.tasks, key.second));
-      Task tsk(ctx, rec);
-      
-      if (!id_sel.empty() && find_ci(id_str(tsk), id_sel) == str::npos) { continue; }
+    auto &idx(ctx.db.tasks_sort);
+    db::Query<Task> q;
+    q.limit = SEARCH_MAX;
+    db::from(q, db::scan(idx), db::SOURCE_ALL);
 
-      if (!tags_sel.empty()) {
-	std::vector<str> diff;
-	std::set_difference(tags_sel.begin(), tags_sel.end(),
-			    tsk.tags.begin(), tsk.tags.end(),
-			    std::back_inserter(diff));
-	if (!diff.empty()) { continue; }
-      }
-      
-      if (!text_sel.empty() &&
-	  find_ci(tsk.name, text_sel) == str::npos &&
-	  find_ci(tsk.info, text_sel) == str::npos) { continue; }
-      
-      if (!prio_str.empty() && prio_sel && tsk.prio > prio_sel) { continue; }
+    if (!prio_str.empty() && prio_sel) {
+      auto cur(db::scan(idx));
+      db::bound(cur, idx.key(prio_sel+1, null_time, null_uid));
+      db::from(q, cur, db::SOURCE_RANGE);
+      db::range(q, task_prio, opt<int64_t>(), opt<int64_t>(prio_sel));
+    }
 
-      if (tsk.done != done_sel) { continue; }
-      
-      auto project_sel(project_fld.selected);
-      if (project_sel && tsk.project_id != project_sel->id) { continue; }
-      
-      if (peer_sel && tsk.owner_id != peer_sel->id) { continue; }
-      
+    db::match(q, ctx.db.tasks_text, idx, text_sel, db::SCAN_FWD);
+    filter_id(q, ctx.db.tasks_ids, idx, db::SCAN_FWD, id_sel);
+    db::tagged(q, ctx.db.tasks_tags, idx, tags_sel, db::SCAN_FWD);
+    db::has_all(q, task_tags, tags_sel);
+    db::contains(q, {&task_name, &task_info}, text_sel);
+    db::eq(q, task_done, done_sel);
+    auto project_sel(project_fld.selected);
+    if (project_sel) { db::eq(q, task_project_id, project_sel->id); }
+    if (peer_sel) { db::eq(q, task_owner_id, peer_sel->id); }
+    
+    for (auto r: db::run(q)) {
+      auto &rec(*r);
+      Task tsk(ctx, rec);
       Project prj(get_project_id(ctx, tsk.project_id));
       Peer own(get_peer_id(ctx, tsk.owner_id));
       GtkTreeIter iter;
@@ -1,4 +1,5 @@
 #include "snackis/ctx.hpp"
+#include "snackis/db/query.hpp"
 #include "snackis/gui/feed_view.hpp"
 #include "snackis/gui/gui.hpp"
 #include "snackis/gui/todo.hpp"
@@ -63,17 +64,19 @@ namespace gui {
     refresh(ctx);
     size_t cnt(0);
     
-    for(const auto &key: ctx.db.tasks_sort.recs) {
-      auto &rec(db::get(ctx.db.tasks, key.second));
+    const Time min_done(now() - std::chrono::hours(TODO_DONE_DAYS*24));
+    db::Query<Task> q;
+    db::tagged(q, ctx.db.tasks_tags, ctx.db.tasks_sort, {"todo"}, db::SCAN_FWD);
+
+    db::filter(q, [min_done](auto &rec) {
+	return !db::get_val(rec, task_done) ||
+	  !(db::get_val(rec, task_done_at) < min_done);
+      });
+    
+    for (auto r: db::run(q)) {
+      auto &rec(*r);
       Task tsk(ctx, rec);
       
-      if (tsk.tags.find("todo") == tsk.tags.end()) { continue; }
-
-      if (tsk.done &&
-	  tsk.done_at < now() - std::chrono::hours(TODO_DONE_DAYS*24)) {
-	continue;
-      }
-	
       GtkTreeIter iter;
       gtk_list_store_append(store, &iter);
       Project prj(get_project_id(ctx, tsk.project_id));
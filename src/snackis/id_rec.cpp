@@ -4,7 +4,9 @@ namespace snackis {
   IdRec::IdRec(Ctx &ctx, opt<UId> id): Rec(ctx), id(id ? *id : true)
   { }
 
-  str id_str(const IdRec &rec) {
-    return to_str(rec.id).substr(0, 8);
+  str id_str(const UId &id) {
+    return to_str(id).substr(0, 8);
   }
+
+  str id_str(const IdRec &rec) { return id_str(rec.id); }
 }
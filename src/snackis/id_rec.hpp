@@ -10,6 +10,7 @@ namespace snackis {
     IdRec(Ctx &ctx, opt<UId> id=nullopt);
   };
 
+  str id_str(const UId &id);
   str id_str(const IdRec &rec);
 }
 
@@ -18,19 +18,9 @@ namespace net {
       for (auto e: errors) { log(ctx, e->what); }
     };
 
-    while (running) {
+    while (true) {
       TRY(try_imap);
-      auto poll(*get_val(ctx.settings.imap.poll));
-      
-      if (poll) {
-	ImapWorker::Lock lock(mutex);
-	go.wait_for(lock, std::chrono::seconds(poll));
-      } else {
-	ImapWorker::Lock lock(mutex);
-	go.wait(lock);
-      }
-
-      if (!running) { break; }
+      if (!wait(*this, *get_val(ctx.settings.imap.poll))) { break; }
 
       refresh(ctx);
       Imap imap(ctx);
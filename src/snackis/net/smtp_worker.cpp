@@ -14,19 +14,9 @@ namespace net {
       for (auto e: errors) { log(ctx, e->what); }
     };
 
-    while (running) {
+    while (true) {
       TRY(try_smtp);
-      auto poll(*get_val(ctx.settings.smtp.poll));
-      
-      if (poll) {
-	SmtpWorker::Lock lock(mutex);
-   	go.wait_for(lock, std::chrono::seconds(poll));	
-      } else {
-	SmtpWorker::Lock lock(mutex);
-   	go.wait(lock);
-      }
-
-      if (!running) { break; }
+      if (!wait(*this, *get_val(ctx.settings.smtp.poll))) { break; }
 
       refresh(ctx);
       if (!ctx.db.outbox.recs.empty()) {
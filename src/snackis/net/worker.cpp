@@ -9,8 +9,11 @@ namespace net {
 
   Worker::Worker(Ctx &ctx):
     ctx(ctx.proc, ctx.inbox.max),
+    go(1),
     running(false) {
     this->ctx.secret = ctx.secret;
+    // Workers never search or list records, copies share records
+    drop_gui_indexes(this->ctx.db);
     db::copy(this->ctx.db.settings, ctx.db.settings);
     db::copy(this->ctx.db.peers, ctx.db.peers);
   }
@@ -18,7 +21,7 @@ namespace net {
   Worker::~Worker() {
     if (running) {
       running = false;
-      go.notify_one();
+      close(go);
       thread.join();
     }
   }
@@ -28,4 +31,16 @@ namespace net {
     w.running = true;
     w.thread = std::thread(do_run, &w);
   }
+
+  void poke(Worker &w) { put(w.go, true, false); }
+
+  bool wait(Worker &w, int64_t poll) {
+    if (poll) {
+      get(w.go, std::chrono::steady_clock::now() + std::chrono::seconds(poll));
+    } else {
+      get(w.go);
+    }
+
+    return !w.go.closed.load();
+  }
 }}
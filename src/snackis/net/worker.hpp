@@ -1,20 +1,17 @@
 #ifndef SNACKIS_NET_WORKER_HPP
 #define SNACKIS_NET_WORKER_HPP
 
-#include <condition_variable>
-#include <mutex>
 #include <thread>
 
 #include "snackis/ctx.hpp"
+#include "snackis/core/chan.hpp"
 
 namespace snackis {
 namespace net {
   struct Worker {
-    using Lock = std::unique_lock<std::mutex>;
-
     Ctx ctx;
-    std::mutex mutex;
-    std::condition_variable go;
+    // Wakes the worker up before its next poll, closed to stop it
+    Chan<bool, CHAN_MULTI, CHAN_SINGLE> go;
     std::thread thread;
     bool running;
     
@@ -24,6 +21,11 @@ namespace net {
   };
 
   void start(Worker &w);
+  void poke(Worker &w);
+
+  // Waits for a poke or poll seconds, forever if 0; returns false once
+  // the worker is stopped
+  bool wait(Worker &w, int64_t poll);
 }}
 
 #endif
@@ -2,10 +2,13 @@
 #define SNACKIS_SETTING_HPP
 
 #include "snackis/rec.hpp"
+#include "snackis/core/defer.hpp"
+#include "snackis/core/int64_type.hpp"
 #include "snackis/core/opt.hpp"
 #include "snackis/core/str.hpp"
 #include "snackis/core/stream.hpp"
 #include "snackis/core/type.hpp"
+#include "snackis/db/proc.hpp"
 
 namespace snackis {
   struct BasicSetting: Rec {
@@ -51,6 +54,23 @@ namespace snackis {
     stn.val = buf.str();
     upsert(stn.ctx.db.settings, dynamic_cast<BasicSetting &>(stn));
   }
+
+  template <typename ValT>
+  void upgrade_val(Setting<ValT> &stn) {
+    load(stn.ctx.db.settings, dynamic_cast<BasicSetting &>(stn));
+    if (stn.val.empty()) { return; }
+    opt<ValT> val;
+    
+    {
+      Stream buf(stn.val);
+      const bool prev_decimal(int64_decimal);
+      int64_decimal = stn.ctx.proc.rev < db::VARINT_REV;
+      DEFER({ int64_decimal = prev_decimal; });
+      val.emplace(stn.type.read(buf));
+    }
+    
+    set_val(stn, *val);
+  }
 }
 
 #endif
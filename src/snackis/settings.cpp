@@ -20,7 +20,25 @@ namespace snackis {
 
     load_folder(ctx, "load_folder", str_type, str("load/")),
     save_folder(ctx, "save_folder", str_type, str("save/")),
+    durability(ctx, "durability", int64_type, int64_t(db::DURABLE_FLUSH)),
     imap(ctx, "imap", 993),
     smtp(ctx, "smtp", 587)
   { }
+
+  static void upgrade(ServerSettings &stn) {
+    upgrade_val(stn.url);
+    upgrade_val(stn.port);
+    upgrade_val(stn.user);
+    upgrade_val(stn.pass);
+    upgrade_val(stn.poll);
+  }
+  
+  void upgrade(Settings &stn) {
+    upgrade_val(stn.whoami);
+    upgrade_val(stn.crypt_key);
+    upgrade_val(stn.load_folder);
+    upgrade_val(stn.save_folder);
+    upgrade(stn.imap);
+    upgrade(stn.smtp);
+  }
 }
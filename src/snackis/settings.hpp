@@ -17,10 +17,13 @@ namespace snackis {
     Setting<UId> whoami;
     Setting<crypt::Key> crypt_key;
     Setting<str> load_folder, save_folder;
+    Setting<int64_t> durability;
     ServerSettings imap, smtp;
     
     Settings(Ctx &ctx);
   };
+
+  void upgrade(Settings &stn);
 }
 
 #endif
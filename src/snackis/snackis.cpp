@@ -7,8 +7,9 @@
 
 namespace snackis {
   const int VERSION[3] = {0, 9, 24};
-  const int64_t DB_REV = 3;
-  const int64_t PROTO_REV = 6;
+  const int64_t DB_REV = 7;
+  const int64_t MIN_DB_REV = 3;
+  const int64_t PROTO_REV = 7;
 
   opt<net::ImapWorker> imap_worker;
   opt<net::SmtpWorker> smtp_worker;
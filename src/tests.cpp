@@ -1,3 +1,4 @@
+#include <fstream>
 #include <iostream>
 
 #include "snackis/ctx.hpp"
@@ -5,7 +6,11 @@
 #include "snackis/core/chan.hpp"
 #include "snackis/core/data.hpp"
 #include "snackis/core/bool_type.hpp"
+#include "snackis/core/btree.hpp"
+#include "snackis/core/hash_map.hpp"
 #include "snackis/core/int64_type.hpp"
+#include "snackis/core/parallel.hpp"
+#include "snackis/core/select.hpp"
 #include "snackis/core/set_type.hpp"
 #include "snackis/core/str_type.hpp"
 #include "snackis/core/str.hpp"
@@ -15,8 +20,13 @@
 #include "snackis/crypt/key.hpp"
 #include "snackis/crypt/secret.hpp"
 #include "snackis/db/col.hpp"
+#include "snackis/db/id_index.hpp"
+#include "snackis/db/index.hpp"
 #include "snackis/db/proc.hpp"
+#include "snackis/db/query.hpp"
 #include "snackis/db/table.hpp"
+#include "snackis/db/tag_index.hpp"
+#include "snackis/db/text_index.hpp"
 #include "snackis/net/imap.hpp"
 
 using namespace snackis;
@@ -25,6 +35,27 @@ using namespace snackis::db;
 static void str_tests() {
   CHECK(find_ci("foo", "bar"), _ == str::npos);
   CHECK(find_ci("foobar", "BAR"), _ == 3);
+  CHECK(term_set("Foo, bar-FOO!"), _ == std::set<str>({"bar", "foo"}));
+}
+
+static void int64_type_tests() {
+  const std::vector<int64_t> vals {
+    0, 1, -1, 63, -64, 64, -65, 1000000, INT64_MAX, INT64_MIN
+  };
+
+  Stream buf;
+  for (auto v: vals) { int64_type.write(v, buf); }
+  for (auto v: vals) { CHECK(int64_type.read(buf), _ == v); }
+
+  buf.str("");
+  int64_type.write(-64, buf);
+  CHECK(buf.str().size(), _ == 1);
+  
+  int64_decimal = true;
+  buf.str("");
+  buf.write("\x03" "-42", 4);
+  CHECK(int64_type.read(buf), _ == -42);
+  int64_decimal = false;
 }
 
 static void crypt_secret_tests() {
@@ -54,7 +85,7 @@ static void crypt_key_tests() {
 }
 
 static void chan_tests() {
-  /*  const int MAX(100);
+  const int MAX(100);
   Chan<int> c(MAX);
 
   CHECK(get(c, false), !_);
@@ -62,9 +93,134 @@ static void chan_tests() {
   CHECK(put(c, 42, false), !_);
   for (int i = 0; i < MAX; i++) { CHECK(get(c), *_ == i); }
   CHECK(get(c, false), !_);
+  CHECK(get(c, std::chrono::steady_clock::now() +
+	    std::chrono::milliseconds(1)), !_);
   CHECK(put(c, 42), _);
 
-  close(c);*/
+  close(c);
+  CHECK(put(c, 43), !_);
+  CHECK(get(c), *_ == 42);
+  CHECK(get(c), !_);
+
+  const int64_t WORKERS(4), REPS(10000);
+  Chan<int64_t> wc(1);
+  std::atomic<int64_t> sum(0);
+  std::vector<std::thread> ts;
+  
+  for (int64_t i(0); i < WORKERS; i++) {
+    ts.emplace_back([&wc]() {
+	for (int64_t j(0); j < REPS; j++) { put(wc, j); }
+      });
+
+    ts.emplace_back([&wc, &sum]() {
+	for (int64_t j(0); j < REPS; j++) { sum += *get(wc); }
+      });
+  }
+
+  for (auto &t: ts) { t.join(); }
+  CHECK(sum.load(), _ == WORKERS * REPS * (REPS-1) / 2);
+  CHECK(get(wc, false), !_);
+
+  Chan<int64_t, CHAN_MULTI, CHAN_SINGLE> mc(10);
+  ts.clear();
+  
+  for (int64_t i(0); i < WORKERS; i++) {
+    ts.emplace_back([&mc]() {
+	for (int64_t j(0); j < REPS; j++) { put(mc, j); }
+      });
+  }
+
+  int64_t msum(0);
+  for (int64_t i(0); i < WORKERS * REPS; i++) { msum += *get(mc); }
+  for (auto &t: ts) { t.join(); }
+  CHECK(msum, _ == WORKERS * REPS * (REPS-1) / 2);
+  
+  Chan<int64_t, CHAN_SINGLE, CHAN_SINGLE> sc(1);
+  CHECK(get(sc, false), !_);
+  CHECK(put(sc, int64_t(1)), _);
+  CHECK(put(sc, int64_t(2), false), !_);
+  CHECK(get(sc), *_ == 1);
+
+  std::thread st([&sc]() {
+      for (int64_t j(0); j < REPS; j++) { put(sc, j); }
+      close(sc);
+    });
+
+  int64_t ssum(0);
+  while (auto v = get(sc)) { ssum += *v; }
+  st.join();
+  CHECK(ssum, _ == REPS * (REPS-1) / 2);
+
+  Chan<std::unique_ptr<int>> pc(1);
+  CHECK(put(pc, std::make_unique<int>(42)), _);
+  CHECK(**get(pc), _ == 42);
+
+  Chan<int> c2(4);
+  std::vector<int> in{1, 2, 3, 4, 5}, out;
+  CHECK(put_all(c2, in.begin(), in.end(), false), _ == 4);
+  CHECK(drain(c2, out, 3), _ == 3);
+  CHECK(put_all(c2, in.begin()+4, in.end()), _ == 1);
+  CHECK(drain(c2, out, 10), _ == 2);
+  CHECK(out == in, _);
+  CHECK(drain(c2, out, 10, false), _ == 0);
+
+  Chan<int64_t> bc(10);
+  std::vector<int64_t> vals;
+  for (int64_t j(0); j < REPS; j++) { vals.push_back(j); }
+  ts.clear();
+  
+  for (int64_t i(0); i < WORKERS; i++) {
+    ts.emplace_back([&bc, &vals]() {
+	CHECK(put_all(bc, vals.begin(), vals.end()), _ == vals.size());
+      });
+  }
+
+  std::vector<int64_t> bout;
+  while (bout.size() < size_t(WORKERS * REPS)) { drain(bc, bout, 7); }
+  for (auto &t: ts) { t.join(); }
+  int64_t bsum(0);
+  for (auto v: bout) { bsum += v; }
+  CHECK(bsum, _ == WORKERS * REPS * (REPS-1) / 2);
+}
+
+static void select_tests() {
+  using namespace std::chrono;
+  Chan<int> ic(10);
+  Chan<str> sc(10);
+  Select sel;
+  int isum(0);
+  str sbuf;
+  bool closed(false);
+
+  recv(sel, ic, [&](auto &v) {
+      if (v) { isum += *v; } else { closed = true; }
+    });
+
+  recv(sel, sc, [&](auto &v) { if (v) { sbuf += *v; } });
+
+  CHECK(select(sel, steady_clock::now() + milliseconds(1)), !_);
+  put(ic, 1);
+  put(ic, 2);
+  put(sc, str("x"));
+  CHECK(select(sel), _);
+  CHECK(isum, _ == 1);
+  CHECK(select(sel), _);
+  CHECK(sbuf, _ == "x");
+  CHECK(select(sel), _);
+  CHECK(isum, _ == 3);
+  
+  std::thread t([&sc]() {
+      std::this_thread::sleep_for(milliseconds(10));
+      put(sc, str("y"));
+    });
+  
+  CHECK(select(sel), _);
+  CHECK(sbuf, _ == "xy");
+  t.join();
+
+  close(ic);
+  CHECK(select(sel), _);
+  CHECK(closed, _);
 }
 
 struct Foo {
@@ -73,6 +229,7 @@ struct Foo {
   Time ftime;
   UId fuid;
   std::set<int64_t> fset;
+  std::set<str> ftags;
   Foo(): fint64(0), ftime(now()), fuid(true) { }
 
   Foo(db::Table<Foo, UId> &tbl, const db::Rec<Foo> &rec) {
@@ -93,11 +250,115 @@ static void fmt_tests() {
   CHECK(fmt("%0 %1 %2", "abc", Foo(), "42"), _ == "abc Foo 42");
 }
 
+static void parallel_tests() {
+  TRY(try_test);
+  std::vector<int64_t> out(100, 0);
+  
+  parallel_for(out.size(), [&](size_t i) {
+      out[i] = i;
+      if (i % 10 == 0) { ERROR(Core, fmt("Failed %0", i)); }
+    });
+
+  for (size_t i(0); i < out.size(); i++) { CHECK(out[i], _ == int64_t(i)); }
+  CHECK(try_test.errors.size(), _ == 10);
+  CHECK(try_test.errors.back()->what.find("Failed 90"), _ != str::npos);
+  for (auto e: try_test.errors) { delete e; }
+  try_test.errors.clear();
+
+  std::atomic<int64_t> sum(0);
+  
+  parallel_for(10, [&](size_t i) {
+      parallel_for(10, [&](size_t j) { sum += i*10 + j; });
+    });
+
+  CHECK(sum.load(), _ == 4950);
+}
+
+struct IntHash {
+  size_t operator ()(int64_t x) const { return x; }
+};
+
+static void hash_map_tests() {
+  HashMap<int64_t, int64_t, IntHash> m;
+  std::map<int64_t, int64_t> ref;
+  
+  for (int64_t i(0); i < 10000; i++) {
+    const int64_t k((i * 7919) % 1000);
+
+    if (i % 3 == 2) {
+      CHECK(m.erase(k), _ == ref.erase(k));
+    } else {
+      auto res(m.emplace(k, i));
+      CHECK(res.second, _ == ref.emplace(k, i).second);
+      CHECK(res.first->second, _ == ref[k]);
+    }
+  }
+
+  CHECK(m.size(), _ == ref.size());
+  size_t n(0);
+  
+  for (auto &it: m) {
+    CHECK(it.second, _ == ref[it.first]);
+    n++;
+  }
+
+  CHECK(n, _ == ref.size());
+  auto fnd(m.find(ref.begin()->first));
+  auto addr(&fnd->second);
+  for (int64_t i(1000); i < 2000; i++) { m.emplace(i, i); }
+  CHECK(&m.find(ref.begin()->first)->second, _ == addr);
+
+  HashMap<int64_t, int64_t, IntHash> cm;
+  copy(cm, m);
+  CHECK(cm.size(), _ == m.size());
+  fnd = cm.find(ref.begin()->first);
+  CHECK(&fnd->second, _ == addr);
+  mut(cm, fnd).second = -1;
+  CHECK(&cm.find(ref.begin()->first)->second, _ != addr);
+  CHECK(m.find(ref.begin()->first)->second, _ == ref.begin()->second);
+}
+
+static void btree_tests() {
+  BTree<int64_t, int64_t, 4> t;
+  std::map<int64_t, int64_t> ref;
+
+  for (int64_t i(0); i < 10000; i++) {
+    const int64_t k((i * 7919) % 1000);
+
+    if (i % 3 == 2) {
+      CHECK(t.erase(k), _ == ref.erase(k));
+    } else {
+      auto res(t.emplace(k, i));
+      CHECK(res.second, _ == ref.emplace(k, i).second);
+      CHECK(res.first->second, _ == ref[k]);
+    }
+  }
+
+  auto eq([](auto &x, auto &y) {
+      return x.first == y.first && x.second == y.second;
+    });
+  
+  CHECK(t.size(), _ == ref.size());
+  CHECK(std::equal(t.begin(), t.end(), ref.begin(), ref.end(), eq), _);
+  CHECK(std::equal(t.rbegin(), t.rend(), ref.rbegin(), ref.rend(), eq), _);
+
+  for (int64_t k(-1); k < 1001; k++) {
+    auto i(t.lower_bound(k));
+    auto j(ref.lower_bound(k));
+    CHECK(i == t.end(), _ == (j == ref.end()));
+    if (j != ref.end()) { CHECK(i->first, _ == j->first); }
+  }
+
+  for (auto &it: ref) { t.erase(it.first); }
+  CHECK(t.empty(), _);
+  CHECK(t.begin() == t.end(), _);
+}
+
 static void schema_tests() {
   const Col<Foo, int64_t> col("int64", int64_type, &Foo::fint64); 
   Schema<Foo> scm({&col});
 
-  Rec<Foo> foo, bar;
+  db::Rec<Foo> foo, bar;
   set(foo, col, int64_t(42));
   CHECK(compare(scm, foo, bar), _ == -1);
 
@@ -116,9 +377,35 @@ SetType<int64_t> int64_set(int64_type);
 const Col<Foo, std::set<int64_t>> set_col("set",
 					  int64_set,
 					  &Foo::fset); 
+const Col<Foo, std::set<str>> tags_col("tags", str_set_type, &Foo::ftags);
 
 const size_t MAX_BUF(32);
 
+static void rec_tests() {
+  Schema<Foo> scm({&int64_col, &str_col, &uid_col});
+  Foo foo;
+  foo.fint64 = 42;
+  foo.fstr = "abc";
+  
+  db::Rec<Foo> rec(scm, foo);
+  CHECK(db::size(rec), _ == 3);
+  CHECK(*get(rec, int64_col), _ == 42);
+  CHECK(get(rec, time_col) ? true : false, !_);
+
+  db::Rec<Foo> copy_rec(rec);
+  set(copy_rec, str_col, str("def"));
+  CHECK(*get(rec, str_col), _ == "abc");
+  CHECK(*get(copy_rec, str_col), _ == "def");
+
+  Foo bar;
+  copy(bar, copy_rec);
+  CHECK(bar.fuid, _ == foo.fuid);
+  CHECK(bar.fstr, _ == "def");
+
+  clear(rec);
+  CHECK(db::empty(rec), _);
+}
+
 void table_insert_tests() {
   Proc proc("testdb/", MAX_BUF);
   db::Ctx ctx(proc, MAX_BUF);
@@ -133,6 +420,51 @@ void table_insert_tests() {
   CHECK(load(tbl, foo), _);
 }
 
+static void trans_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "trans_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col});
+
+  Trans trans(ctx);
+  
+  for (int i = 0; i < 1000; i++) {
+    Foo foo;
+    foo.fint64 = i;
+    CHECK(insert(tbl, foo), _);
+  }
+
+  CHECK(trans.changes->changes.size(), _ == 1000);
+  CHECK(trans.changes->chunks.size(), _ > 1);
+  rollback(trans);
+  CHECK(trans.changes, !_);
+  CHECK(tbl.recs.size(), _ == 0);
+}
+
+static void refresh_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF), rctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "refresh_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col}),
+    rtbl(rctx, "refresh_tests", db::make_key(uid_col),
+	 {&int64_col, &str_col, &time_col});
+
+  Foo foo, bar;
+  Trans trans(ctx);
+  CHECK(insert(tbl, foo), _);
+  commit(trans, nullopt);
+  CHECK(insert(tbl, bar), _);
+  commit(trans, nullopt);
+  CHECK(proc.feed.entries.size(), _ == 2);
+  CHECK(refresh(ctx), _ == 0);
+  
+  CHECK(refresh(rctx), _ == 2);
+  CHECK(load(rtbl, foo), _);
+  CHECK(load(rtbl, bar), _);
+  CHECK(proc.feed.entries.empty(), _);
+  CHECK(refresh(rctx), _ == 0);
+}
+
 static void table_slurp_tests() {
   Proc proc("testdb/", MAX_BUF);
   db::Ctx ctx(proc, MAX_BUF);
@@ -155,6 +487,556 @@ static void table_slurp_tests() {
   CHECK(load(tbl, bar), _);
 }
 
+static void table_index_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "index_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col});
+  db::KeyIndex<Foo, int64_t, UId> idx(db::make_key(int64_col, uid_col));
+  tbl.indexes.insert(&idx);
+  
+  Foo foo, bar;
+  foo.fint64 = 2;
+  bar.fint64 = 1;
+  Trans trans(ctx);
+  CHECK(insert(tbl, foo), _);
+  CHECK(insert(tbl, bar), _);
+  CHECK(idx.recs.size(), _ == 2);
+  CHECK(Foo(tbl, *idx.recs.begin()->second).fuid, _ == bar.fuid);
+
+  bar.fint64 = 3;
+  CHECK(update(tbl, bar), _);
+  CHECK(idx.recs.size(), _ == 2);
+  CHECK(Foo(tbl, *idx.recs.begin()->second).fuid, _ == foo.fuid);
+  commit(trans, nullopt);
+  
+  CHECK(erase(tbl, foo), _);
+  CHECK(idx.recs.size(), _ == 1);
+  rollback(trans);
+  CHECK(idx.recs.size(), _ == 2);
+  CHECK(Foo(tbl, *idx.recs.begin()->second).fint64, _ == 2);
+  
+  Stream buf;
+  dump(tbl, buf);
+  tbl.recs.clear();
+  slurp(tbl, buf);
+  CHECK(idx.recs.size(), _ == 2);
+  CHECK(Foo(tbl, *idx.recs.rbegin()->second).fuid, _ == bar.fuid);
+
+  // Records are indexed after update hooks have run
+  tbl.on_update.push_back([](auto &prev, auto &curr) {
+      db::set(curr, int64_col, int64_t(42));
+    });
+  
+  bar.fstr = "changed";
+  CHECK(update(tbl, bar), _);
+  CHECK(Foo(tbl, *idx.recs.rbegin()->second).fint64, _ == 42);
+  CHECK(erase(tbl, bar), _);
+  CHECK(idx.recs.size(), _ == 1);
+  commit(trans, nullopt);
+}
+
+static void table_scan_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "scan_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col});
+  db::KeyIndex<Foo, int64_t, UId> idx(db::make_key(int64_col, uid_col));
+  tbl.indexes.insert(&idx);
+  
+  Trans trans(ctx);
+  for (int64_t i: {1, 1, 2, 2, 2, 3}) {
+    Foo foo;
+    foo.fint64 = i;
+    CHECK(insert(tbl, foo), _);
+  }
+
+  auto cnt([](auto &cur) {
+      size_t n(0);
+      while (db::next_rec(cur)) { n++; }
+      return n;
+    });
+
+  auto fwd(db::scan(idx));
+  CHECK(cnt(fwd), _ == 6);
+  
+  auto pre(db::scan(idx));
+  db::seek(pre, idx.key(2, null_uid), 1);
+  CHECK(Foo(tbl, *db::next_rec(pre)).fint64, _ == 2);
+  CHECK(cnt(pre), _ == 2);
+
+  auto rev(db::scan(idx, db::SCAN_REV));
+  db::seek(rev, idx.key(3, null_uid));
+  db::bound(rev, idx.key(2, null_uid));
+  CHECK(cnt(rev), _ == 3);
+
+  auto lim(db::scan(idx, db::SCAN_REV));
+  lim.limit = 2;
+  CHECK(Foo(tbl, *db::next_rec(lim)).fint64, _ == 3);
+  CHECK(cnt(lim), _ == 1);
+
+  auto none(db::scan(idx, db::SCAN_REV));
+  db::seek(none, idx.key(1, null_uid));
+  CHECK(db::next_rec(none), !_);
+}
+
+static void table_query_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "query_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col});
+  db::KeyIndex<Foo, int64_t, UId> idx(db::make_key(int64_col, uid_col));
+  tbl.indexes.insert(&idx);
+  
+  Trans trans(ctx);
+  for (int64_t i(0); i < 10; i++) {
+    Foo foo;
+    foo.fint64 = i;
+    foo.fstr = (i % 2) ? "Odd" : "even";
+    CHECK(insert(tbl, foo), _);
+  }
+
+  db::Query<Foo> q;
+  db::from(q, db::scan(idx), db::SOURCE_ALL);
+  auto cur(db::scan(idx));
+  db::seek(cur, idx.key(3, null_uid));
+  db::bound(cur, idx.key(8, null_uid));
+  db::from(q, cur, db::SOURCE_RANGE);
+  db::from(q, db::scan(idx, db::SCAN_REV), db::SOURCE_ALL);
+  CHECK(q.rank, _ == db::SOURCE_RANGE);
+  db::range(q, int64_col, opt<int64_t>(3), opt<int64_t>(7));
+  db::contains(q, {&str_col}, "odd");
+  auto res(db::run(q));
+  CHECK(res.size(), _ == 3);
+  CHECK(*db::get(*res.front(), int64_col), _ == 3);
+
+  q.limit = 2;
+  CHECK(db::run(q).size(), _ == 2);
+}
+
+static void table_text_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "text_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col});
+  db::TextIndex<Foo> idx({&str_col});
+  tbl.indexes.insert(&idx);
+  
+  Foo foo, bar;
+  foo.fstr = "Snackis rocks";
+  bar.fstr = "Snabel scripts";
+  Trans trans(ctx);
+  CHECK(insert(tbl, foo), _);
+  CHECK(insert(tbl, bar), _);
+  CHECK(db::match(idx, "sna").size(), _ == 2);
+  CHECK(db::match(idx, "SNA roc").size(), _ == 1);
+  CHECK(db::match(idx, "ocks").empty(), _);
+
+  bar.fstr = "Snabel rocks";
+  CHECK(update(tbl, bar), _);
+  CHECK(db::match(idx, "rocks").size(), _ == 2);
+  CHECK(db::match(idx, "scripts").empty(), _);
+  commit(trans, nullopt);
+
+  CHECK(erase(tbl, foo), _);
+  CHECK(db::match(idx, "snackis").empty(), _);
+  rollback(trans);
+  CHECK(db::match(idx, "snackis").size(), _ == 1);
+}
+
+static void table_tag_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "tag_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col, &tags_col});
+  db::TagIndex<Foo> idx(tags_col);
+  tbl.indexes.insert(&idx);
+  
+  Trans trans(ctx);
+  for (int64_t i(0); i < 100; i++) {
+    Foo foo;
+    if (!(i % 2)) { foo.ftags.insert("even"); }
+    if (!(i % 3)) { foo.ftags.insert("three"); }
+    CHECK(insert(tbl, foo), _);
+  }
+
+  CHECK(db::find(idx, {"even"}).size(), _ == 50);
+  CHECK(db::find(idx, {"even", "three"}).size(), _ == 17);
+  CHECK(db::find(idx, {"even", "odd"}).empty(), _);
+
+  Foo foo(tbl, *db::find(idx, {"even", "three"}).front());
+  CHECK(erase(tbl, foo), _);
+  CHECK(db::find(idx, {"even", "three"}).size(), _ == 16);
+  CHECK(db::find(idx, {"even"}).size(), _ == 49);
+  rollback(trans);
+  CHECK(idx.tags.empty(), _);
+}
+
+static void table_id_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "id_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col});
+  db::IdIndex<Foo> idx(db::make_key(uid_col));
+  tbl.indexes.insert(&idx);
+  
+  Trans trans(ctx);
+  std::vector<Foo> foos(100);
+  for (auto &foo: foos) { CHECK(insert(tbl, foo), _); }
+
+  for (auto &foo: foos) {
+    const str id(to_str(foo.fuid));
+    auto found(db::find_prefix(idx, id.substr(0, 8)));
+    CHECK(found.size(), _ == 1);
+    CHECK(Foo(tbl, *found.front()).fuid, _ == foo.fuid);
+    CHECK(db::find_prefix(idx, id).size(), _ == 1);
+  }
+
+  CHECK(db::find_prefix(idx, "").empty(), _);
+  CHECK(db::find_prefix(idx, "xyz").empty(), _);
+  
+  size_t n(0);
+  for (auto c: str("0123456789ABCDEF")) { n += db::find_prefix(idx, str(1, c)).size(); }
+  CHECK(n, _ == foos.size());
+}
+
+static void table_copy_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF), cctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "copy_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col}),
+    ctbl(cctx, "copy_tests", db::make_key(uid_col),
+	 {&int64_col, &str_col, &time_col});
+
+  Foo foo;
+  foo.fint64 = 1;
+  Trans trans(ctx);
+  CHECK(insert(tbl, foo), _);
+  commit(trans, nullopt);
+
+  copy(ctbl, tbl);
+  CHECK(&get(ctbl, foo.fuid), _ == &get(tbl, foo.fuid));
+  Trans ctrans(cctx);
+  foo.fint64 = 2;
+  CHECK(update(ctbl, foo), _);
+  rollback(ctrans);
+  CHECK(&get(ctbl, foo.fuid), _ != &get(tbl, foo.fuid));
+  CHECK(Foo(tbl, get(tbl, foo.fuid)).fint64, _ == 1);
+  CHECK(Foo(ctbl, get(ctbl, foo.fuid)).fint64, _ == 1);
+}
+
+static void table_schema_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "schema_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col}),
+    rtbl(ctx, "schema_tests_reordered", db::make_key(uid_col),
+	 {&time_col, &str_col, &int64_col});
+
+  Foo foo;
+  foo.fint64 = 42;
+  foo.fstr = "abc";
+  Trans trans(ctx);
+  CHECK(insert(tbl, foo), _);
+
+  Stream buf;
+  dump(tbl, buf);
+  slurp(rtbl, buf);
+
+  Foo rfoo(rtbl, get(rtbl, foo.fuid));
+  CHECK(rfoo.fint64, _ == 42);
+  CHECK(rfoo.fstr, _ == "abc");
+  CHECK(rfoo.ftime, _ == foo.ftime);
+}
+
+static void table_map_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  ctx.secret.emplace();
+  init(*ctx.secret, "secret key");
+  Table<Foo, UId> tbl(ctx, "map_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col, &set_col});
+
+  Foo foo, bar;
+  foo.fstr = "abc";
+  for (int i = 0; i < 100; i++) { bar.fset.insert(i); }
+  tbl.recs.emplace(tbl.key(foo), db::Rec<Foo>(tbl, foo));
+  tbl.recs.emplace(tbl.key(bar), db::Rec<Foo>(tbl, bar));
+
+  for (int i = 0; i < 1000; i++) {
+    Foo baz;
+    baz.fint64 = i;
+    tbl.recs.emplace(tbl.key(baz), db::Rec<Foo>(tbl, baz));
+  }
+  
+  std::ofstream f(tbl.path.string(),
+		  std::ios::out | std::ios::binary | std::ios::trunc);
+  dump(tbl, f);
+  foo.fstr = "def";
+  write(tbl, db::TABLE_UPDATE, db::Rec<Foo>(tbl, foo), f);
+  f.close();
+  
+  for (auto map_files: {false, true}) {
+    proc.map_files = map_files;
+    tbl.recs.clear();
+    slurp(tbl);
+    CHECK(tbl.recs.size(), _ == 1002);
+    CHECK(Foo(tbl, get(tbl, foo.fuid)).fstr, _ == "def");
+    CHECK(Foo(tbl, get(tbl, bar.fuid)).fset.size(), _ == 100);
+  }
+}
+
+static void table_compact_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "compact_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col});
+
+  Foo foo;
+  Trans trans(ctx);
+  CHECK(insert(tbl, foo), _);
+  commit(trans, nullopt);
+
+  for (int i = 1; i <= 100; i++) {
+    foo.fint64 = i;
+    CHECK(update(tbl, foo), _);
+    commit(trans, nullopt);
+  }
+
+  CHECK(rewrite(ctx), _ > 0);
+  CHECK(path_exists(tbl.path.string() + ".tmp"), !_);
+  tbl.recs.clear();
+  slurp(tbl);
+  CHECK(tbl.recs.size(), _ == 1);
+  CHECK(tbl.dead_bytes, _ == 0);
+  CHECK(Foo(tbl, get(tbl, foo.fuid)).fint64, _ == 100);
+
+  {
+    Table<Foo, UId> tmp(ctx, "compact_drop_tests", db::make_key(uid_col),
+			{&int64_col, &str_col, &time_col});
+    CHECK(insert(tmp, foo), _);
+    commit(trans, nullopt);
+    CHECK(sync(ctx), _);
+    CHECK(compact(proc.write_loop, tmp), _);
+  }
+
+  // Dropping the table waits until the compaction has been handled
+  CHECK(proc.write_loop.compactions.empty(), _);
+}
+
+static void table_upgrade_tests() {
+  Foo foo;
+
+  {
+    Proc proc("testdb/", MAX_BUF);
+    db::Ctx ctx(proc, MAX_BUF);
+    Table<Foo, UId> tbl(ctx, "upgrade_tests", db::make_key(uid_col),
+			{&int64_col, &str_col, &time_col});
+    Trans trans(ctx);
+    CHECK(insert(tbl, foo), _);
+    commit(trans, nullopt);
+
+    for (int i = 1; i <= 10; i++) {
+      foo.fint64 = i;
+      CHECK(update(tbl, foo), _);
+      commit(trans, nullopt);
+    }
+  }
+
+  Path tbl_path, upgraded;
+  
+  {
+    Proc proc("testdb/", MAX_BUF);
+    db::Ctx ctx(proc, MAX_BUF);
+    Table<Foo, UId> tbl(ctx, "upgrade_tests", db::make_key(uid_col),
+			{&int64_col, &str_col, &time_col});
+    slurp(tbl);
+    proc.rev = DB_REV-1;
+    upgrade(ctx);
+    CHECK(proc.rev, _ == DB_REV);
+    CHECK(tbl.dead_bytes, _ == 0);
+    tbl_path = tbl.path;
+    upgraded = upgrade_path(tbl.path);
+    CHECK(path_exists(upgraded), !_);
+  }
+
+  // Simulate an upgrade interrupted after writing the revision
+  CHECK(rename_path(tbl_path, upgraded), _);
+  std::ofstream(tbl_path.string(), std::ios::out | std::ios::trunc);
+  Proc proc("testdb/", MAX_BUF);
+  CHECK(path_exists(upgraded), !_);
+  db::Ctx ctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "upgrade_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col});
+  slurp(tbl);
+  CHECK(tbl.recs.size(), _ == 1);
+  CHECK(Foo(tbl, get(tbl, foo.fuid)).fint64, _ == 10);
+}
+
+static void table_snapshot_tests() {
+  Foo foo;
+
+  {
+    Proc proc("testdb/", MAX_BUF);
+    db::Ctx ctx(proc, MAX_BUF);
+    Table<Foo, UId> tbl(ctx, "snapshot_tests", db::make_key(uid_col),
+			{&int64_col, &str_col, &time_col});
+    Trans trans(ctx);
+    CHECK(insert(tbl, foo), _);
+    commit(trans, nullopt);
+
+    for (int i = 1; i <= 10; i++) {
+      foo.fint64 = i;
+      CHECK(update(tbl, foo), _);
+      commit(trans, nullopt);
+    }
+  }
+  
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "snapshot_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col});
+  const int64_t snap_size(path_size(tbl.path));
+  std::ofstream snap(tbl.snap_path.string(),
+		     std::ios::out | std::ios::binary | std::ios::trunc);
+  write_snapshot_header(snap_size, 0, snap);
+  compact(tbl, snap_size, snap);
+  snap.close();
+  
+  std::ofstream log(tbl.path.string(),
+		    std::ios::out | std::ios::binary | std::ios::app);
+  write_schema(tbl, log);
+  foo.fint64 = 11;
+  write(tbl, db::TABLE_UPDATE, db::Rec<Foo>(tbl, foo), log);
+  log.flush();
+  const int64_t log_size(path_size(tbl.path));
+  
+  Stream buf;
+  foo.fint64 = 12;
+  write(tbl, db::TABLE_UPDATE, db::Rec<Foo>(tbl, foo), buf);
+  log << buf.str().substr(0, buf.str().size() / 2);
+  log.close();
+
+  for (auto map_files: {false, true}) {
+    proc.map_files = map_files;
+    tbl.recs.clear();
+    slurp(tbl);
+    CHECK(tbl.recs.size(), _ == 1);
+    CHECK(Foo(tbl, get(tbl, foo.fuid)).fint64, _ == 11);
+    CHECK(path_size(tbl.path), _ == log_size);
+  }
+
+  // Invalid ops are errors and leave the log alone
+  log.open(tbl.path.string(), std::ios::out | std::ios::binary | std::ios::app);
+  log << char(0xff) << buf.str();
+  log.close();
+  const int64_t bad_size(path_size(tbl.path));
+  
+  for (auto map_files: {false, true}) {
+    TRY(try_corrupt);
+    proc.map_files = map_files;
+    tbl.recs.clear();
+    slurp(tbl);
+    CHECK(try_corrupt.errors.empty(), !_);
+    CHECK(path_size(tbl.path), _ == bad_size);
+    for (auto e: try_corrupt.errors) { delete e; }
+    try_corrupt.errors.clear();
+  }
+
+  CHECK(resize_path(tbl.path, log_size), _);
+
+  proc.snapshot_size = 1;
+  Trans trans(ctx);
+  
+  for (int i = 12; i <= 20; i++) {
+    foo.fint64 = i;
+    CHECK(update(tbl, foo), _);
+    commit(trans, nullopt);
+  }
+
+  CHECK(rewrite(ctx), _ >= 0);
+  CHECK(path_exists(tbl.snap_path), !_);
+  tbl.recs.clear();
+  slurp(tbl);
+  CHECK(Foo(tbl, get(tbl, foo.fuid)).fint64, _ == 20);
+}
+
+static void table_page_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  ctx.secret.emplace();
+  init(*ctx.secret, "secret key");
+  Table<Foo, UId> tbl(ctx, "page_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col}),
+    rtbl(ctx, "page_tests_records", db::make_key(uid_col),
+	 {&int64_col, &str_col, &time_col});
+
+  Trans trans(ctx);
+  
+  for (auto t: {&rtbl, &tbl}) {
+    proc.page_size = (t == &tbl) ? 1024 : 0;
+    
+    for (int i = 0; i < 100; i++) {
+      Foo foo;
+      foo.fint64 = i;
+      CHECK(insert(*t, foo), _);
+    }
+
+    commit(trans, nullopt);
+    // The write loop reads page_size as it writes
+    CHECK(sync(ctx), _);
+  }
+  
+  CHECK(path_size(tbl.path), _ < path_size(rtbl.path));
+
+  for (auto map_files: {false, true}) {
+    proc.map_files = map_files;
+    tbl.recs.clear();
+    slurp(tbl);
+    CHECK(tbl.recs.size(), _ == 100);
+  }
+}
+
+static void table_durability_tests() {
+  Proc proc("testdb/", MAX_BUF);
+  db::Ctx ctx(proc, MAX_BUF);
+  Table<Foo, UId> tbl(ctx, "durability_tests", db::make_key(uid_col),
+		      {&int64_col, &str_col, &time_col});
+
+  for (auto d: {db::DURABLE_NONE, db::DURABLE_GROUP, db::DURABLE_COMMIT}) {
+    proc.durability = d;
+    auto prev(proc.write_loop.stats);
+    Trans trans(ctx);
+
+    for (int i = 0; i < 10; i++) {
+      Foo foo;
+      CHECK(insert(tbl, foo), _);
+      commit(trans, nullopt);
+    }
+
+    CHECK(sync(ctx), _);
+    auto &stats(proc.write_loop.stats);
+    CHECK(stats.commits - prev.commits, _ == 10);
+    const int64_t syncs(stats.syncs - prev.syncs);
+
+    switch (d) {
+    case db::DURABLE_NONE:
+      CHECK(syncs, _ == 0);
+      break;
+    case db::DURABLE_GROUP:
+      CHECK(syncs, _ > 0 && _ <= stats.groups - prev.groups);
+      CHECK(syncs, _ <= 10);
+      break;
+    default:
+      CHECK(syncs, _ == 10);
+    }
+  }
+
+  tbl.recs.clear();
+  slurp(tbl);
+  CHECK(tbl.recs.size(), _ == 30);
+}
+
 static void read_write_tests() {
   Proc proc("testdb/", MAX_BUF);
   db::Ctx ctx(proc, MAX_BUF);
@@ -170,12 +1052,12 @@ static void read_write_tests() {
   foo.ftime = now();
   for (int i = 0; i < 100; i++) { foo.fset.insert(i); }
   
-  Rec<Foo> rec;
+  db::Rec<Foo> rec;
   copy(tbl, rec, foo);
   
   Stream buf;
   write(rec, buf, sec);
-  Rec<Foo> rrec;
+  db::Rec<Foo> rrec;
   read(tbl, buf, rrec, sec);
   CHECK(compare(tbl, rrec, rec), _ == 0);
 }
@@ -201,12 +1083,34 @@ int main() {
   
   str_tests();
   fmt_tests();
+  int64_type_tests();
   crypt_secret_tests();
   crypt_key_tests();
   chan_tests();
+  select_tests();
+  parallel_tests();
+  hash_map_tests();
+  btree_tests();
   schema_tests();
+  rec_tests();
   table_insert_tests();
+  trans_tests();
+  refresh_tests();
   table_slurp_tests();
+  table_index_tests();
+  table_scan_tests();
+  table_query_tests();
+  table_text_tests();
+  table_tag_tests();
+  table_id_tests();
+  table_copy_tests();
+  table_schema_tests();
+  table_map_tests();
+  table_compact_tests();
+  table_upgrade_tests();
+  table_snapshot_tests();
+  table_page_tests();
+  table_durability_tests();
   read_write_tests();
   //email_tests();
   snabel::all_tests();